@@ -17,15 +17,40 @@
 #pragma once
 
 #include <array>
+#include <charconv>
 #include <cstring>
-#include <functional>
+#include <deque>
+#include <limits>
 #include <string>
+#include <string_view>
 #include <utility>
 
 #include "esp_log.h"
 
+#include "inplace_function.h"
+
+#if defined(COMPILE_FOR_NATIVE) && defined(__linux__)
+/* Drain the socket with recvmmsg() instead of one async_receive_from() per datagram */
+#define ASIO_UDP_CLIENT_USE_RECVMMSG
+#include <sys/socket.h>
+#endif /* COMPILE_FOR_NATIVE && __linux__ */
+
 static constexpr const int RX_BUFFER_SIZE = 2048;
 static constexpr const int TX_BUFFER_SIZE = 2048;
+/** Maximum number of datagrams received with one recvmmsg() call */
+static constexpr const int RX_BATCH_SIZE = 8;
+/** Number of tx buffers, i.e. how many messages can be queued for sending */
+static constexpr const int TX_QUEUE_DEPTH = 4;
+/** The rtp socket only sends the 12 byte header from its tx buffer, the frame is sent from where it is stored */
+static constexpr const int RTP_TX_BUFFER_SIZE = 16;
+/** One frame every 20 ms */
+static constexpr const int RTP_TX_QUEUE_DEPTH = 2;
+/** 20 ms G.711 frames with the rtp header, larger frames are not buffered anyway (see RtpReceiver) */
+static constexpr const int RTP_RX_BUFFER_SIZE = 512;
+/** Maximum number of body fragments passed to send_buffered_data() */
+static constexpr const int TX_MAX_BODY_FRAGMENTS = 3;
+/** Default number of messages, that are queued on the heap while all tx buffers are in use */
+static constexpr const int TX_BACKLOG_LIMIT = 32;
 
 #ifndef COMPILE_FOR_NATIVE
 /* Workaround for asio esp-idf issue
@@ -37,6 +62,13 @@ static constexpr const int TX_BUFFER_SIZE = 2048;
 __attribute__((weak)) char* if_indextoname(unsigned int, char*) { return 0; }
 #endif
 
+/**
+ * Fixed size buffer to build a message by appending fragments
+ *
+ * The buffer tracks the written length, so appending does not depend on the amount
+ * of data already in the buffer. The content is always null terminated.
+ * Fragments that do not fit anymore are cut and the buffer is marked as truncated.
+ */
 template <std::size_t SIZE>
 class Buffer
 {
@@ -48,25 +80,27 @@ public:
 
     void clear()
     {
+        m_size = 0;
+        m_truncated = false;
         m_buffer[0] = '\0';
     }
 
     Buffer<SIZE>& operator<<(const char* str)
     {
-        strncat(m_buffer.data(), str, m_buffer.size() - strlen(m_buffer.data()) - 1);
-        return *this;
+        return append(str, strlen(str));
     }
-    Buffer<SIZE>& operator<<(const std::string& str)
+
+    Buffer<SIZE>& operator<<(std::string_view str)
     {
-        strncat(m_buffer.data(), str.c_str(), m_buffer.size() - strlen(m_buffer.data()) - 1);
-        return *this;
+        return append(str.data(), str.size());
     }
 
     template <typename T>
     typename std::enable_if<std::is_unsigned_v<T>, Buffer<SIZE>&>::type operator<<(T i)
     {
-        snprintf(m_buffer.data() + strlen(m_buffer.data()), m_buffer.size() - strlen(m_buffer.data()), "%u", static_cast<unsigned>(i));
-        return *this;
+        std::array<char, std::numeric_limits<T>::digits10 + 1> digits {};
+        const auto result = std::to_chars(digits.data(), digits.data() + digits.size(), i);
+        return append(digits.data(), static_cast<size_t>(result.ptr - digits.data()));
     }
 
     [[nodiscard]] const char* data() const
@@ -76,15 +110,46 @@ public:
 
     [[nodiscard]] size_t size() const
     {
-        return strlen(m_buffer.data());
+        return m_size;
+    }
+
+    /**
+     * True if some appended data did not fit into the buffer
+     */
+    [[nodiscard]] bool is_truncated() const
+    {
+        return m_truncated;
     }
 
 private:
+    Buffer<SIZE>& append(const char* str, size_t length)
+    {
+        const size_t available = m_buffer.size() - m_size - 1;
+        if (length > available)
+        {
+            length = available;
+            m_truncated = true;
+        }
+        memcpy(m_buffer.data() + m_size, str, length);
+        m_size += length;
+        m_buffer[m_size] = '\0';
+        return *this;
+    }
+
     std::array<char, SIZE> m_buffer;
+    size_t m_size { 0 };
+    bool m_truncated { false };
 };
 
 using TxBufferT = Buffer<TX_BUFFER_SIZE>;
 
+/**
+ * Called for every received datagram
+ *
+ * The data points into the rx buffer of the socket and is only valid during the call.
+ */
+using RxCallbackT = InplaceFunction<void(std::string_view)>;
+
 #ifndef COMPILE_FOR_NATIVE
 class TcpIpAdapterInitializer
 {
@@ -96,17 +161,32 @@ public:
 };
 #endif /* COMPILE_FOR_NATIVE */
 
-class AsioUdpClient
+/**
+ * Udp socket with a send queue of TX_SLOTS tx buffers
+ *
+ * \tparam TX_SLOTS Number of messages, that can be queued for sending
+ * \tparam TX_SLOT_SIZE Size of each tx buffer, body fragments are sent from where they are stored
+ * \tparam RX_SIZE Size of the rx buffer, longer datagrams are cut
+ */
+template <size_t TX_SLOTS, size_t TX_SLOT_SIZE, size_t RX_SIZE>
+class BasicAsioUdpClient
 {
 public:
-    AsioUdpClient(asio::io_context& io_context, std::string server_ip, std::string server_port, uint16_t local_port, std::function<void(std::string)> on_received)
+    using TxBuffer = Buffer<TX_SLOT_SIZE>;
+    /** The socket for the rtp of a sip client with this socket */
+    using RtpSocketT = BasicAsioUdpClient<RTP_TX_QUEUE_DEPTH, RTP_TX_BUFFER_SIZE, RTP_RX_BUFFER_SIZE>;
+
+    BasicAsioUdpClient(asio::io_context& io_context, std::string server_ip, std::string server_port, uint16_t local_port, RxCallbackT on_received)
         : m_io_context(io_context)
         , m_server_port(std::move(server_port))
         , m_server_ip(std::move(server_ip))
         , m_local_port(local_port)
         , m_socket { io_context }
-        , m_on_received { std::move(on_received) }
+        , m_on_received { on_received }
     {
+#ifdef ASIO_UDP_CLIENT_USE_RECVMMSG
+        init_rx_batch();
+#endif /* ASIO_UDP_CLIENT_USE_RECVMMSG */
     }
 
     void set_server_ip(const std::string& server_ip)
@@ -118,6 +198,31 @@ public:
         m_server_ip = server_ip;
     }
 
+    /**
+     * Sends to another address than the server from now on, e.g. the RTP address negotiated with SDP
+     *
+     * Only valid until the next init(), which resolves the server again.
+     */
+    bool set_destination(std::string_view ip, uint16_t port)
+    {
+        std::array<char, 16> address {};
+        if (ip.size() >= address.size())
+        {
+            ESP_LOGW(TAG, "Invalid destination address %.*s", static_cast<int>(ip.size()), ip.data());
+            return false;
+        }
+        ip.copy(address.data(), ip.size());
+        asio::error_code ec;
+        const asio::ip::address_v4 destination = asio::ip::make_address_v4(address.data(), ec);
+        if (ec)
+        {
+            ESP_LOGW(TAG, "Invalid destination address %s: %s", address.data(), ec.message().c_str());
+            return false;
+        }
+        m_destination_endpoint = asio::ip::udp::endpoint(destination, port);
+        return true;
+    }
+
     void deinit()
     {
         if (!is_initialized())
@@ -178,50 +283,216 @@ public:
         return m_socket.is_open();
     }
 
+#ifdef ASIO_UDP_CLIENT_USE_RECVMMSG
+    /**
+     * Waits until the socket is readable and then receives all pending datagrams
+     *
+     * Up to RX_BATCH_SIZE datagrams are read with a single recvmmsg() call into
+     * preallocated buffers and then handed to the receive callback one after the other.
+     */
+    void do_receive()
+    {
+        m_socket.async_wait(asio::ip::udp::socket::wait_read,
+            [this](std::error_code ec) {
+                if (ec)
+                {
+                    ESP_LOGD(TAG, "Failed to wait for data, error=%s", ec.message().c_str());
+                    if (m_socket.is_open())
+                    {
+                        do_receive();
+                    }
+                    return;
+                }
+                int received = 0;
+                do
+                {
+                    received = recvmmsg(m_socket.native_handle(), m_rx_msgs.data(), m_rx_msgs.size(), MSG_DONTWAIT, nullptr);
+                    for (int i = 0; i < received; i++)
+                    {
+                        handle_received(m_rx_buffers[i].data(), m_rx_msgs[i].msg_len);
+                    }
+                } while (received == RX_BATCH_SIZE);
+                do_receive();
+            });
+    }
+#else
     void do_receive()
     {
         m_socket.async_receive_from(
             asio::buffer(m_rx_buffer), m_sender_endpoint,
             [this](std::error_code ec, std::size_t bytes_recvd) {
-                if (!ec && bytes_recvd > 0)
+                if (!ec)
                 {
-                    m_rx_buffer[bytes_recvd] = '\0';
-                    ESP_LOGV(TAG, "Received %d byte", bytes_recvd);
-                    ESP_LOGV(TAG, "Received following data: %s", m_rx_buffer.data());
-                    if (m_on_received)
-                    {
-                        m_on_received(std::string(m_rx_buffer.data(), bytes_recvd));
-                    }
+                    handle_received(m_rx_buffer.data(), bytes_recvd);
                 }
                 do_receive();
             });
     }
+#endif /* ASIO_UDP_CLIENT_USE_RECVMMSG */
+
+    /**
+     * Returns the next free tx buffer of the send queue
+     *
+     * The buffer stays owned by the queue until it was sent, so a message can be
+     * built while the previous ones are still being sent.
+     */
+    TxBuffer& get_new_tx_buf()
+    {
+        TxBuffer& buffer = has_free_slot() ? m_tx_slots[(m_tx_first + m_tx_count) % m_tx_slots.size()].buffer : m_tx_overflow_buffer;
+        buffer.clear();
+        return buffer;
+    }
 
-    TxBufferT& get_new_tx_buf()
+    /**
+     * Number of messages, that are queued on the heap while all tx buffers are in use, before messages are dropped
+     */
+    void set_tx_backlog_limit(size_t limit)
     {
-        m_tx_buffer.clear();
-        return m_tx_buffer;
+        m_tx_backlog_limit = limit;
     }
 
-    bool send_buffered_data()
+    /**
+     * Queues the content of the last tx buffer followed by the given body fragments for sending
+     *
+     * All parts are sent as one datagram (gathered by the socket), so e.g. a message body
+     * can be sent directly from where it is stored without copying it into the tx buffer first.
+     * This never blocks, the datagram is sent asynchronously by the io_context.
+     *
+     * While all tx buffers are in use, e.g. for the replies to a whole batch of received datagrams,
+     * the message is copied with its body into the backlog on the heap and sent after the queued ones.
+     *
+     * \param[in] body asio::const_buffer fragments appended after the tx buffer content.
+     *                 The data must stay valid until the datagram is sent.
+     */
+    template <typename... Fragments>
+    bool send_buffered_data(const Fragments&... body)
     {
-        ESP_LOGV(TAG, "Sending %d byte", m_tx_buffer.size());
-        ESP_LOGV(TAG, "Sending following data: %s", m_tx_buffer.data());
-        const asio::socket_base::message_flags flags = 0;
-        asio::error_code ec;
+        static_assert(sizeof...(Fragments) <= TX_MAX_BODY_FRAGMENTS, "Too many body fragments");
+        if (!has_free_slot())
+        {
+            return queue_backlog(body...);
+        }
+        TxSlot& slot = m_tx_slots[(m_tx_first + m_tx_count) % m_tx_slots.size()];
+        if (slot.buffer.is_truncated())
+        {
+            ESP_LOGE(TAG, "Message does not fit into the tx buffer (%d byte), not sending it", static_cast<int>(TX_SLOT_SIZE));
+            return false;
+        }
+        ESP_LOGV(TAG, "Sending following data: %s", slot.buffer.data());
+        slot.fragments = { asio::buffer(slot.buffer.data(), slot.buffer.size()), asio::const_buffer(body)... };
+
+        m_tx_count++;
+        if (m_tx_count == 1)
+        {
+            do_send();
+        }
+        return true;
+    }
+
+private:
+    /**
+     * A message goes into a tx buffer, if one is free and no older message waits in the backlog
+     */
+    [[nodiscard]] bool has_free_slot() const
+    {
+        return (m_tx_count < m_tx_slots.size()) && m_tx_backlog.empty();
+    }
+
+    template <typename... Fragments>
+    bool queue_backlog(const Fragments&... body)
+    {
+        if (m_tx_overflow_buffer.is_truncated())
+        {
+            ESP_LOGE(TAG, "Message does not fit into the tx buffer (%d byte), not sending it", static_cast<int>(TX_SLOT_SIZE));
+            return false;
+        }
+        if (m_tx_backlog.size() >= m_tx_backlog_limit)
+        {
+            ESP_LOGE(TAG, "Send backlog is full (%d messages), dropping message", static_cast<int>(m_tx_backlog.size()));
+            return false;
+        }
+        std::string& message = m_tx_backlog.emplace_back(m_tx_overflow_buffer.data(), m_tx_overflow_buffer.size());
+        (message.append(static_cast<const char*>(asio::const_buffer(body).data()), asio::const_buffer(body).size()), ...);
+        // the tx buffers are all in use, so a send is in progress and continues with the backlog
+        return true;
+    }
 
-        const size_t result = m_socket.send_to(
-            asio::buffer(m_tx_buffer.data(), m_tx_buffer.size()), m_destination_endpoint, flags, ec);
+    void handle_received(const char* data, std::size_t length)
+    {
+        if (length == 0)
+        {
+            return;
+        }
+        ESP_LOGV(TAG, "Received %d byte", static_cast<int>(length));
+        ESP_LOGV(TAG, "Received following data: %.*s", static_cast<int>(length), data);
+        if (m_on_received)
+        {
+            m_on_received(std::string_view(data, length));
+        }
+    }
 
-        if (ec || (result <= 0))
+#ifdef ASIO_UDP_CLIENT_USE_RECVMMSG
+    /**
+     * Points the message headers of the recvmmsg() batch to the rx buffers
+     */
+    void init_rx_batch()
+    {
+        for (size_t i = 0; i < m_rx_msgs.size(); i++)
         {
-            ESP_LOGD(TAG, "Failed to send data %d, error=%s", result, ec.message().c_str());
+            m_rx_iovecs[i].iov_base = m_rx_buffers[i].data();
+            m_rx_iovecs[i].iov_len = m_rx_buffers[i].size();
+            m_rx_msgs[i].msg_hdr.msg_iov = &m_rx_iovecs[i];
+            m_rx_msgs[i].msg_hdr.msg_iovlen = 1;
         }
+    }
+#endif /* ASIO_UDP_CLIENT_USE_RECVMMSG */
 
-        return result == m_tx_buffer.size();
+    /**
+     * Header and body fragments of one queued datagram
+     */
+    struct TxSlot
+    {
+        TxBuffer buffer;
+        std::array<asio::const_buffer, 1 + TX_MAX_BODY_FRAGMENTS> fragments;
+    };
+
+    /**
+     * Sends the first queued datagram, the completion handler continues with the next one
+     *
+     * The tx buffers are sent first, the backlog only holds messages that were queued after them.
+     */
+    void do_send()
+    {
+        const bool from_slot = (m_tx_count > 0);
+        const auto on_sent = [this, from_slot](std::error_code ec, std::size_t /*bytes_sent*/) {
+            if (ec)
+            {
+                ESP_LOGD(TAG, "Failed to send data, error=%s", ec.message().c_str());
+            }
+            if (from_slot)
+            {
+                m_tx_first = (m_tx_first + 1) % m_tx_slots.size();
+                m_tx_count--;
+            }
+            else
+            {
+                m_tx_backlog.pop_front();
+            }
+            if ((m_tx_count > 0) || !m_tx_backlog.empty())
+            {
+                do_send();
+            }
+        };
+        if (from_slot)
+        {
+            m_socket.async_send_to(m_tx_slots[m_tx_first].fragments, m_destination_endpoint, on_sent);
+        }
+        else
+        {
+            m_socket.async_send_to(asio::buffer(m_tx_backlog.front()), m_destination_endpoint, on_sent);
+        }
     }
 
-private:
 #ifndef COMPILE_FOR_NATIVE
     TcpIpAdapterInitializer m_initializer;
 #endif /* COMPILE_FOR_NATIVE */
@@ -230,12 +501,30 @@ private:
     std::string m_server_ip;
     const uint16_t m_local_port;
 
-    TxBufferT m_tx_buffer;
-    std::array<char, RX_BUFFER_SIZE> m_rx_buffer {};
+    std::array<TxSlot, TX_SLOTS> m_tx_slots {};
+    /** Index of the slot that is currently sent */
+    size_t m_tx_first { 0 };
+    /** Number of queued slots, including the one that is currently sent */
+    size_t m_tx_count { 0 };
+    /** Returned by get_new_tx_buf() if no tx buffer is free, copied into the backlog */
+    TxBuffer m_tx_overflow_buffer;
+    /** Messages queued while all tx buffers were in use, in the order they are sent */
+    std::deque<std::string> m_tx_backlog;
+    size_t m_tx_backlog_limit { TX_BACKLOG_LIMIT };
+#ifdef ASIO_UDP_CLIENT_USE_RECVMMSG
+    std::array<std::array<char, RX_SIZE>, RX_BATCH_SIZE> m_rx_buffers {};
+    std::array<iovec, RX_BATCH_SIZE> m_rx_iovecs {};
+    std::array<mmsghdr, RX_BATCH_SIZE> m_rx_msgs {};
+#else
+    std::array<char, RX_SIZE> m_rx_buffer {};
+    asio::ip::udp::endpoint m_sender_endpoint;
+#endif /* ASIO_UDP_CLIENT_USE_RECVMMSG */
     asio::ip::udp::socket m_socket;
-    std::function<void(std::string)> m_on_received;
+    RxCallbackT m_on_received;
     asio::ip::udp::endpoint m_destination_endpoint;
-    asio::ip::udp::endpoint m_sender_endpoint;
 
     static constexpr const char* TAG = "UdpSocket";
 };
+
+/** The sip socket */
+using AsioUdpClient = BasicAsioUdpClient<TX_QUEUE_DEPTH, TX_BUFFER_SIZE, RX_BUFFER_SIZE>;
@@ -0,0 +1,168 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * Hash algorithms of the sip digest authentication (RFC 2617, RFC 8760)
+ */
+enum class DigestAlgorithm : uint8_t
+{
+    MD5,
+    SHA_256,
+};
+
+static constexpr size_t DIGEST_ALGORITHM_COUNT = 2;
+
+/**
+ * Returns the name used in the algorithm parameter, e.g. "SHA-256"
+ */
+constexpr std::string_view digest_algorithm_name(DigestAlgorithm algorithm)
+{
+    return (algorithm == DigestAlgorithm::SHA_256) ? "SHA-256" : "MD5";
+}
+
+/**
+ * Reads the value of an algorithm parameter, a missing parameter means MD5
+ *
+ * \return false for unsupported algorithms, e.g. SHA-512-256 or MD5-sess
+ */
+inline bool parse_digest_algorithm(std::string_view name, DigestAlgorithm& algorithm)
+{
+    const auto equals_ignore_case = [](std::string_view a, std::string_view b) {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            const auto lower = [](char c) {
+                return ((c >= 'A') && (c <= 'Z')) ? static_cast<char>(c - 'A' + 'a') : c;
+            };
+            if (lower(a[i]) != lower(b[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (name.empty() || equals_ignore_case(name, "MD5"))
+    {
+        algorithm = DigestAlgorithm::MD5;
+        return true;
+    }
+    if (equals_ignore_case(name, "SHA-256"))
+    {
+        algorithm = DigestAlgorithm::SHA_256;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Common part of all digest backends
+ *
+ * A backend (e.g. MbedtlsMd5 or SoftwareSha256) derives from DigestBase<Backend> and provides:
+ * - static constexpr DigestAlgorithm ALGORITHM
+ * - static constexpr size_t DIGEST_SIZE, the size of the hash in bytes
+ * - void start()
+ * - void update(const unsigned char* input, size_t length)
+ * - void finish(std::array<unsigned char, DIGEST_SIZE>& hash)
+ * - using DigestBase<Backend>::update, for the overloads below
+ */
+template <typename BackendT>
+class DigestBase
+{
+public:
+    void update(std::string_view input)
+    {
+        static_cast<BackendT*>(this)->update(reinterpret_cast<const unsigned char*>(input.data()), input.size());
+    }
+
+    /**
+     * Feeds several fragments one after the other, e.g. update(user, ":", realm, ":", pwd),
+     * without concatenating them first
+     */
+    template <typename... Parts>
+    void update(std::string_view first, std::string_view second, const Parts&... rest)
+    {
+        update(first);
+        update(second);
+        (update(std::string_view(rest)), ...);
+    }
+};
+
+/**
+ * Placeholder for a digest backend, that is not compiled in (void)
+ */
+struct NoDigest
+{
+};
+
+template <typename BackendT>
+using DigestOrNone = std::conditional_t<std::is_void_v<BackendT>, NoDigest, BackendT>;
+
+/**
+ * Returns the hash as lower case hex digits, without any heap allocation
+ */
+template <size_t SIZE>
+std::array<char, 2 * SIZE> to_hex(const std::array<unsigned char, SIZE>& data)
+{
+    constexpr std::string_view hexits = "0123456789abcdef";
+    std::array<char, 2 * SIZE> digits {};
+    for (size_t i = 0; i < SIZE; i++)
+    {
+        digits[2 * i] = hexits[data[i] >> 4];
+        digits[2 * i + 1] = hexits[data[i] & 0x0F];
+    }
+    return digits;
+}
+
+/**
+ * Hex digits of a hash of any of the supported algorithms
+ */
+class HexDigest
+{
+public:
+    template <size_t SIZE>
+    void assign(const std::array<unsigned char, SIZE>& hash)
+    {
+        static_assert(2 * SIZE <= MAX_SIZE, "Hash is too large");
+        const std::array<char, 2 * SIZE> digits = to_hex(hash);
+        std::copy(digits.begin(), digits.end(), m_digits.begin());
+        m_size = digits.size();
+    }
+
+    [[nodiscard]] std::string_view view() const
+    {
+        return { m_digits.data(), m_size };
+    }
+
+private:
+    /** SHA-256 */
+    static constexpr size_t MAX_SIZE = 64;
+
+    std::array<char, MAX_SIZE> m_digits {};
+    size_t m_size { 0 };
+};
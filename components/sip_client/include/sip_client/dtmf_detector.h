@@ -0,0 +1,92 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "rtp_packet.h"
+
+#include <cstdint>
+
+/**
+ * Detects key presses in the telephone-event packets (RFC 4733) of one call
+ *
+ * All packets of an event carry the timestamp of its start, the sender repeats them with a growing
+ * duration while the key is held and retransmits the last one (with the end bit) three times.
+ * A key press is reported with the first packet of the event, i.e. one packetization interval
+ * after the key went down, all following packets of the event are swallowed.
+ */
+class DtmfDetector
+{
+public:
+    /** Clock rate of telephone-event, as offered in the SDP (telephone-event/8000) */
+    static constexpr uint16_t CLOCK_RATE_KHZ = 8;
+
+    /**
+     * \return true if the packet starts a new key press, the duration is the one known so far
+     */
+    bool detect(const RtpPacket& packet, const TelephoneEvent& event)
+    {
+        if (event.dtmf_signal() == ' ')
+        {
+            // no DTMF key, e.g. a fax tone
+            return false;
+        }
+        const uint32_t timestamp = packet.get_timestamp();
+        if (m_has_event)
+        {
+            if (static_cast<int32_t>(timestamp - m_timestamp) < 0)
+            {
+                // a late retransmission of an earlier event
+                return false;
+            }
+            if (event.event == m_event)
+            {
+                if (timestamp == m_timestamp)
+                {
+                    // an update or one of the retransmitted ends
+                    m_ended = m_ended || event.end;
+                    return false;
+                }
+                if (!m_ended && !packet.get_marker())
+                {
+                    // a long event is continued with a new timestamp, when its duration overflows (RFC 4733 2.5.1.3)
+                    m_timestamp = timestamp;
+                    m_ended = event.end;
+                    return false;
+                }
+            }
+        }
+        m_has_event = true;
+        m_timestamp = timestamp;
+        m_event = event.event;
+        m_ended = event.end;
+        return true;
+    }
+
+    /**
+     * Forgets the last event, e.g. at the start of a call
+     */
+    void reset()
+    {
+        m_has_event = false;
+    }
+
+private:
+    bool m_has_event { false };
+    bool m_ended { false };
+    uint8_t m_event { 0 };
+    uint32_t m_timestamp { 0 };
+};
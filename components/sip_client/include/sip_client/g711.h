@@ -0,0 +1,325 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Common parts of the G.711 codecs (PCMU and PCMA), that convert 16 bit linear samples to 8 bit codes
+ *
+ * A single sample is decoded with a table of all 256 codes, the encoder looks up the segment
+ * (the exponent of the code) in a table, too. The frame functions of the codecs encode with AVX2
+ * or SSE2 if available (scalar e.g. on the ESP32) and decode with AVX2, they return the same values
+ * as the single sample functions. Without AVX2 the table lookups decode faster than the
+ * arithmetic, because SSE2 has no variable shift.
+ */
+class G711Codec
+{
+protected:
+    /** Index of the highest set bit (0 for 0), the segment of a magnitude without its mantissa bits */
+    static constexpr std::array<uint8_t, 256> SEGMENTS = []() {
+        std::array<uint8_t, 256> segments {};
+        for (size_t i = 2; i < segments.size(); i++)
+        {
+            segments[i] = static_cast<uint8_t>(segments[i / 2] + 1);
+        }
+        return segments;
+    }();
+
+#if defined(__AVX2__)
+    static __m256i select(__m256i mask, __m256i a, __m256i b)
+    {
+        return _mm256_or_si256(_mm256_and_si256(mask, a), _mm256_andnot_si256(mask, b));
+    }
+
+    /**
+     * Shifts each lane by its shift (0 to 7), there is no variable shift of 16 bit lanes before AVX-512
+     */
+    static __m256i shift_left(__m256i value, __m256i shift)
+    {
+        const __m256i one = _mm256_set1_epi16(1);
+        const __m256i two = _mm256_set1_epi16(2);
+        const __m256i four = _mm256_set1_epi16(4);
+        value = select(_mm256_cmpeq_epi16(_mm256_and_si256(shift, one), one), _mm256_slli_epi16(value, 1), value);
+        value = select(_mm256_cmpeq_epi16(_mm256_and_si256(shift, two), two), _mm256_slli_epi16(value, 2), value);
+        return select(_mm256_cmpeq_epi16(_mm256_and_si256(shift, four), four), _mm256_slli_epi16(value, 4), value);
+    }
+#endif
+
+    /**
+     * Converts a frame with the vectorized lane functions of CodecT, the rest sample by sample
+     */
+    template <typename CodecT>
+    static void encode_frame(const int16_t* samples, size_t count, uint8_t* codes)
+    {
+        size_t i = 0;
+#if defined(__AVX2__)
+        for (; i < count - count % 32; i += 32)
+        {
+            const __m256i low = CodecT::encode_lanes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i)));
+            const __m256i high = CodecT::encode_lanes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i + 16)));
+            // packus works within the 128 bit halves, restore the order of the quadwords
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + i), packed);
+        }
+#elif defined(__SSE2__)
+        for (; i < count - count % 16; i += 16)
+        {
+            const __m128i low = CodecT::encode_lanes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i)));
+            const __m128i high = CodecT::encode_lanes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i + 8)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i), _mm_packus_epi16(low, high));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            codes[i] = CodecT::encode(samples[i]);
+        }
+    }
+
+    template <typename CodecT>
+    static void decode_frame(const uint8_t* codes, size_t count, int16_t* samples)
+    {
+        size_t i = 0;
+#if defined(__AVX2__)
+        for (; i < count - count % 16; i += 16)
+        {
+            const __m256i code = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(samples + i), CodecT::decode_lanes(code));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            samples[i] = CodecT::decode(codes[i]);
+        }
+    }
+};
+
+/**
+ * G.711 mu-law, payload type 0
+ */
+class PcmuCodec : private G711Codec
+{
+public:
+    static constexpr uint8_t PAYLOAD_TYPE = 0;
+    static constexpr std::string_view ENCODING_NAME = "PCMU";
+
+    static uint8_t encode(int16_t sample)
+    {
+        // the magnitude of negative samples is ~sample (-sample - 1) as in the ITU-T G.191 reference, so that -32768 fits
+        const bool negative = sample < 0;
+        const int magnitude = std::min(negative ? ~sample : static_cast<int>(sample), CLIP) + BIAS;
+        const uint8_t segment = SEGMENTS[magnitude >> 7];
+        const auto code = static_cast<uint8_t>((segment << 4) | ((magnitude >> (segment + 3)) & 0x0F));
+        return code ^ (negative ? 0x7F : 0xFF);
+    }
+
+    static int16_t decode(uint8_t code)
+    {
+        return DECODED[code];
+    }
+
+    static void encode(const int16_t* samples, size_t count, uint8_t* codes)
+    {
+        encode_frame<PcmuCodec>(samples, count, codes);
+    }
+
+    static void decode(const uint8_t* codes, size_t count, int16_t* samples)
+    {
+        decode_frame<PcmuCodec>(codes, count, samples);
+    }
+
+private:
+    friend class G711Codec;
+
+    static constexpr int BIAS = 0x84;
+    /** Larger magnitudes exceed the highest segment after adding the bias */
+    static constexpr int CLIP = 32635;
+
+    static constexpr std::array<int16_t, 256> DECODED = []() {
+        std::array<int16_t, 256> decoded {};
+        for (size_t i = 0; i < decoded.size(); i++)
+        {
+            const auto code = static_cast<int>(~i & 0xFF);
+            const int value = (((code & 0x0F) << 3) + BIAS) << ((code & 0x70) >> 4);
+            decoded[i] = static_cast<int16_t>(((code & 0x80) != 0) ? (BIAS - value) : (value - BIAS));
+        }
+        return decoded;
+    }();
+
+#if defined(__AVX2__)
+    static __m256i encode_lanes(__m256i sample)
+    {
+        const __m256i sign = _mm256_srai_epi16(sample, 15);
+        const __m256i magnitude = _mm256_add_epi16(_mm256_min_epi16(_mm256_xor_si256(sample, sign), _mm256_set1_epi16(CLIP)), _mm256_set1_epi16(BIAS));
+        // the segment counts the reached thresholds, the mantissa is magnitude >> (segment + 3),
+        // computed as the high half of magnitude * 2^(13 - segment)
+        __m256i segment = _mm256_setzero_si256();
+        __m256i factor = _mm256_set1_epi16(1 << 13);
+        for (int threshold = 0x100; threshold <= 0x4000; threshold <<= 1)
+        {
+            const __m256i reached = _mm256_cmpgt_epi16(magnitude, _mm256_set1_epi16(static_cast<int16_t>(threshold - 1)));
+            segment = _mm256_sub_epi16(segment, reached);
+            factor = _mm256_sub_epi16(factor, _mm256_and_si256(reached, _mm256_srli_epi16(factor, 1)));
+        }
+        const __m256i mantissa = _mm256_and_si256(_mm256_mulhi_epu16(magnitude, factor), _mm256_set1_epi16(0x0F));
+        const __m256i code = _mm256_or_si256(_mm256_slli_epi16(segment, 4), mantissa);
+        return _mm256_xor_si256(code, _mm256_xor_si256(_mm256_set1_epi16(0xFF), _mm256_and_si256(sign, _mm256_set1_epi16(0x80))));
+    }
+
+    static __m256i decode_lanes(__m256i code)
+    {
+        const __m256i inverted = _mm256_xor_si256(code, _mm256_set1_epi16(0xFF));
+        __m256i value = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(inverted, _mm256_set1_epi16(0x0F)), 3), _mm256_set1_epi16(BIAS));
+        value = shift_left(value, _mm256_srli_epi16(_mm256_and_si256(inverted, _mm256_set1_epi16(0x70)), 4));
+        value = _mm256_sub_epi16(value, _mm256_set1_epi16(BIAS));
+        const __m256i negative = _mm256_cmpeq_epi16(_mm256_and_si256(inverted, _mm256_set1_epi16(0x80)), _mm256_set1_epi16(0x80));
+        return _mm256_sub_epi16(_mm256_xor_si256(value, negative), negative);
+    }
+#elif defined(__SSE2__)
+    static __m128i encode_lanes(__m128i sample)
+    {
+        const __m128i sign = _mm_srai_epi16(sample, 15);
+        const __m128i magnitude = _mm_add_epi16(_mm_min_epi16(_mm_xor_si128(sample, sign), _mm_set1_epi16(CLIP)), _mm_set1_epi16(BIAS));
+        // the segment counts the reached thresholds, the mantissa is magnitude >> (segment + 3),
+        // computed as the high half of magnitude * 2^(13 - segment)
+        __m128i segment = _mm_setzero_si128();
+        __m128i factor = _mm_set1_epi16(1 << 13);
+        for (int threshold = 0x100; threshold <= 0x4000; threshold <<= 1)
+        {
+            const __m128i reached = _mm_cmpgt_epi16(magnitude, _mm_set1_epi16(static_cast<int16_t>(threshold - 1)));
+            segment = _mm_sub_epi16(segment, reached);
+            factor = _mm_sub_epi16(factor, _mm_and_si128(reached, _mm_srli_epi16(factor, 1)));
+        }
+        const __m128i mantissa = _mm_and_si128(_mm_mulhi_epu16(magnitude, factor), _mm_set1_epi16(0x0F));
+        const __m128i code = _mm_or_si128(_mm_slli_epi16(segment, 4), mantissa);
+        return _mm_xor_si128(code, _mm_xor_si128(_mm_set1_epi16(0xFF), _mm_and_si128(sign, _mm_set1_epi16(0x80))));
+    }
+#endif
+};
+
+/**
+ * G.711 A-law, payload type 8
+ */
+class PcmaCodec : private G711Codec
+{
+public:
+    static constexpr uint8_t PAYLOAD_TYPE = 8;
+    static constexpr std::string_view ENCODING_NAME = "PCMA";
+
+    static uint8_t encode(int16_t sample)
+    {
+        // the 13 bit magnitude of negative samples is ~sample >> 3 (-(sample >> 3) - 1)
+        const bool negative = sample < 0;
+        const int magnitude = (negative ? ~sample : static_cast<int>(sample)) >> 3;
+        const uint8_t segment = SEGMENTS[magnitude >> 4];
+        const int shift = (segment == 0) ? 1 : segment;
+        const auto code = static_cast<uint8_t>((segment << 4) | ((magnitude >> shift) & 0x0F));
+        return code ^ (negative ? 0x55 : 0xD5);
+    }
+
+    static int16_t decode(uint8_t code)
+    {
+        return DECODED[code];
+    }
+
+    static void encode(const int16_t* samples, size_t count, uint8_t* codes)
+    {
+        encode_frame<PcmaCodec>(samples, count, codes);
+    }
+
+    static void decode(const uint8_t* codes, size_t count, int16_t* samples)
+    {
+        decode_frame<PcmaCodec>(codes, count, samples);
+    }
+
+private:
+    friend class G711Codec;
+
+    static constexpr std::array<int16_t, 256> DECODED = []() {
+        std::array<int16_t, 256> decoded {};
+        for (size_t i = 0; i < decoded.size(); i++)
+        {
+            const auto code = static_cast<int>(i ^ 0x55);
+            const int segment = (code & 0x70) >> 4;
+            int value = ((code & 0x0F) << 4) + ((segment == 0) ? 8 : 0x108);
+            value <<= (segment > 1) ? segment - 1 : 0;
+            decoded[i] = static_cast<int16_t>(((code & 0x80) != 0) ? value : -value);
+        }
+        return decoded;
+    }();
+
+#if defined(__AVX2__)
+    static __m256i encode_lanes(__m256i sample)
+    {
+        const __m256i sign = _mm256_srai_epi16(sample, 15);
+        const __m256i magnitude = _mm256_srli_epi16(_mm256_xor_si256(sample, sign), 3);
+        // as for PCMU, but the mantissa is magnitude >> 1 in the segments 0 and 1
+        __m256i segment = _mm256_sub_epi16(_mm256_setzero_si256(), _mm256_cmpgt_epi16(magnitude, _mm256_set1_epi16(0x1F)));
+        __m256i factor = _mm256_set1_epi16(static_cast<int16_t>(0x8000));
+        for (int threshold = 0x40; threshold <= 0x800; threshold <<= 1)
+        {
+            const __m256i reached = _mm256_cmpgt_epi16(magnitude, _mm256_set1_epi16(static_cast<int16_t>(threshold - 1)));
+            segment = _mm256_sub_epi16(segment, reached);
+            factor = _mm256_sub_epi16(factor, _mm256_and_si256(reached, _mm256_srli_epi16(factor, 1)));
+        }
+        const __m256i mantissa = _mm256_and_si256(_mm256_mulhi_epu16(magnitude, factor), _mm256_set1_epi16(0x0F));
+        const __m256i code = _mm256_or_si256(_mm256_slli_epi16(segment, 4), mantissa);
+        return _mm256_xor_si256(code, _mm256_xor_si256(_mm256_set1_epi16(0xD5), _mm256_and_si256(sign, _mm256_set1_epi16(0x80))));
+    }
+
+    static __m256i decode_lanes(__m256i code)
+    {
+        const __m256i toggled = _mm256_xor_si256(code, _mm256_set1_epi16(0x55));
+        const __m256i segment = _mm256_srli_epi16(_mm256_and_si256(toggled, _mm256_set1_epi16(0x70)), 4);
+        __m256i value = _mm256_slli_epi16(_mm256_and_si256(toggled, _mm256_set1_epi16(0x0F)), 4);
+        // + 8 in segment 0, + 0x108 in all others
+        const __m256i first = _mm256_cmpeq_epi16(segment, _mm256_setzero_si256());
+        value = _mm256_add_epi16(value, _mm256_sub_epi16(_mm256_set1_epi16(0x108), _mm256_and_si256(first, _mm256_set1_epi16(0x100))));
+        value = shift_left(value, _mm256_subs_epu16(segment, _mm256_set1_epi16(1)));
+        const __m256i negative = _mm256_cmpeq_epi16(_mm256_and_si256(toggled, _mm256_set1_epi16(0x80)), _mm256_setzero_si256());
+        return _mm256_sub_epi16(_mm256_xor_si256(value, negative), negative);
+    }
+#elif defined(__SSE2__)
+    static __m128i encode_lanes(__m128i sample)
+    {
+        const __m128i sign = _mm_srai_epi16(sample, 15);
+        const __m128i magnitude = _mm_srli_epi16(_mm_xor_si128(sample, sign), 3);
+        // as for PCMU, but the mantissa is magnitude >> 1 in the segments 0 and 1
+        __m128i segment = _mm_sub_epi16(_mm_setzero_si128(), _mm_cmpgt_epi16(magnitude, _mm_set1_epi16(0x1F)));
+        __m128i factor = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+        for (int threshold = 0x40; threshold <= 0x800; threshold <<= 1)
+        {
+            const __m128i reached = _mm_cmpgt_epi16(magnitude, _mm_set1_epi16(static_cast<int16_t>(threshold - 1)));
+            segment = _mm_sub_epi16(segment, reached);
+            factor = _mm_sub_epi16(factor, _mm_and_si128(reached, _mm_srli_epi16(factor, 1)));
+        }
+        const __m128i mantissa = _mm_and_si128(_mm_mulhi_epu16(magnitude, factor), _mm_set1_epi16(0x0F));
+        const __m128i code = _mm_or_si128(_mm_slli_epi16(segment, 4), mantissa);
+        return _mm_xor_si128(code, _mm_xor_si128(_mm_set1_epi16(0xD5), _mm_and_si128(sign, _mm_set1_epi16(0x80))));
+    }
+#endif
+};
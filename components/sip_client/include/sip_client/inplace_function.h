@@ -0,0 +1,72 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, std::size_t CAPACITY = 2 * sizeof(void*)>
+class InplaceFunction;
+
+/**
+ * Callback wrapper that never allocates
+ *
+ * Like std::function, but the callable is always stored inside of the object.
+ * Only trivially copyable callables that fit into CAPACITY bytes are accepted
+ * (e.g. lambdas capturing a few pointers or references), which is checked at
+ * compile time.
+ */
+template <typename R, typename... Args, std::size_t CAPACITY>
+class InplaceFunction<R(Args...), CAPACITY>
+{
+public:
+    InplaceFunction() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InplaceFunction>>>
+    InplaceFunction(F&& f)
+    {
+        using FunctorT = std::decay_t<F>;
+        static_assert(sizeof(FunctorT) <= CAPACITY, "Callable does not fit into the InplaceFunction");
+        static_assert(alignof(FunctorT) <= alignof(std::max_align_t), "Callable is over-aligned");
+        static_assert(std::is_trivially_copyable_v<FunctorT>, "Callable must be trivially copyable");
+        static_assert(std::is_trivially_destructible_v<FunctorT>, "Callable must be trivially destructible");
+
+        new (m_storage.data()) FunctorT(std::forward<F>(f));
+        m_invoke = [](void* storage, Args... args) -> R {
+            return (*static_cast<FunctorT*>(storage))(std::forward<Args>(args)...);
+        };
+    }
+
+    R operator()(Args... args) const
+    {
+        return m_invoke(m_storage.data(), std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const
+    {
+        return m_invoke != nullptr;
+    }
+
+private:
+    using InvokeT = R (*)(void*, Args...);
+
+    alignas(std::max_align_t) mutable std::array<unsigned char, CAPACITY> m_storage {};
+    InvokeT m_invoke { nullptr };
+};
@@ -16,11 +16,21 @@
 
 #pragma once
 
+#include "digest.h"
+
 #include "mbedtls/md5.h"
 
-class MbedtlsMd5
+#include <array>
+#include <cstddef>
+
+class MbedtlsMd5 : public DigestBase<MbedtlsMd5>
 {
 public:
+    static constexpr DigestAlgorithm ALGORITHM = DigestAlgorithm::MD5;
+    static constexpr size_t DIGEST_SIZE = 16;
+
+    using DigestBase<MbedtlsMd5>::update;
+
     MbedtlsMd5()
     {
         mbedtls_md5_init(&m_ctx);
@@ -41,12 +51,12 @@ public:
         mbedtls_md5_starts(&m_ctx);
     }
 
-    void update(const std::string& input)
+    void update(const unsigned char* input, size_t length)
     {
-        mbedtls_md5_update(&m_ctx, reinterpret_cast<const unsigned char*>(input.c_str()), input.size());
+        mbedtls_md5_update(&m_ctx, input, length);
     }
 
-    void finish(std::array<unsigned char, 16>& hash)
+    void finish(std::array<unsigned char, DIGEST_SIZE>& hash)
     {
         mbedtls_md5_finish(&m_ctx, hash.data());
     }
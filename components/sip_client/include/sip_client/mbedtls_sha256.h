@@ -0,0 +1,67 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "digest.h"
+
+#include "mbedtls/sha256.h"
+
+#include <array>
+#include <cstddef>
+
+class MbedtlsSha256 : public DigestBase<MbedtlsSha256>
+{
+public:
+    static constexpr DigestAlgorithm ALGORITHM = DigestAlgorithm::SHA_256;
+    static constexpr size_t DIGEST_SIZE = 32;
+
+    using DigestBase<MbedtlsSha256>::update;
+
+    MbedtlsSha256()
+    {
+        mbedtls_sha256_init(&m_ctx);
+    }
+
+    ~MbedtlsSha256()
+    {
+        mbedtls_sha256_free(&m_ctx);
+    }
+
+    MbedtlsSha256(const MbedtlsSha256&) = delete;
+    MbedtlsSha256& operator=(const MbedtlsSha256&) = delete;
+    MbedtlsSha256(const MbedtlsSha256&&) = delete;
+    MbedtlsSha256& operator=(const MbedtlsSha256&&) = delete;
+
+    void start()
+    {
+        // 0 selects SHA-256 instead of SHA-224
+        mbedtls_sha256_starts(&m_ctx, 0);
+    }
+
+    void update(const unsigned char* input, size_t length)
+    {
+        mbedtls_sha256_update(&m_ctx, input, length);
+    }
+
+    void finish(std::array<unsigned char, DIGEST_SIZE>& hash)
+    {
+        mbedtls_sha256_finish(&m_ctx, hash.data());
+    }
+
+private:
+    mbedtls_sha256_context m_ctx {};
+};
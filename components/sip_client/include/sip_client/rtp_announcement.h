@@ -0,0 +1,270 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "asio.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * An announcement, e.g. "please wait, someone is coming", encoded into 20 ms G.711 frames
+ *
+ * All frames are stored back to back in one contiguous buffer, frame i starts at i * FRAME_SIZE.
+ * The buffer is either encoded once at startup or an already encoded file, e.g. mapped into
+ * memory or embedded into the flash, that is used in place.
+ */
+class Announcement
+{
+public:
+    /** 20 ms at 8 kHz, as advertised with a=ptime:20 */
+    static constexpr size_t FRAME_SIZE = 160;
+
+    Announcement() = default;
+
+    // a copy would point into the storage of the original, a move takes the storage in place and empties the source
+    Announcement(const Announcement&) = delete;
+    Announcement& operator=(const Announcement&) = delete;
+
+    Announcement(Announcement&& other) noexcept
+        : m_storage(std::move(other.m_storage))
+        , m_codes(std::exchange(other.m_codes, nullptr))
+        , m_size(std::exchange(other.m_size, 0))
+        , m_payload_type(other.m_payload_type)
+    {
+    }
+
+    Announcement& operator=(Announcement&& other) noexcept
+    {
+        m_storage = std::move(other.m_storage);
+        m_codes = std::exchange(other.m_codes, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_payload_type = other.m_payload_type;
+        return *this;
+    }
+
+    /**
+     * Encodes the samples (8 kHz, mono) with CodecT, the last frame is filled up with silence
+     */
+    template <typename CodecT>
+    static Announcement encode(const int16_t* samples, size_t count)
+    {
+        Announcement announcement;
+        announcement.m_payload_type = CodecT::PAYLOAD_TYPE;
+        announcement.m_storage.resize((count + FRAME_SIZE - 1) / FRAME_SIZE * FRAME_SIZE, CodecT::encode(0));
+        CodecT::encode(samples, count, announcement.m_storage.data());
+        announcement.m_codes = announcement.m_storage.data();
+        announcement.m_size = announcement.m_storage.size();
+        return announcement;
+    }
+
+    /**
+     * Uses already encoded codes without copying them, they must outlive the announcement
+     *
+     * An incomplete last frame is not played.
+     */
+    static Announcement view(uint8_t payload_type, const uint8_t* codes, size_t size)
+    {
+        Announcement announcement;
+        announcement.m_payload_type = payload_type;
+        announcement.m_codes = codes;
+        announcement.m_size = size - size % FRAME_SIZE;
+        return announcement;
+    }
+
+    [[nodiscard]] uint8_t get_payload_type() const
+    {
+        return m_payload_type;
+    }
+
+    [[nodiscard]] size_t frame_count() const
+    {
+        return m_size / FRAME_SIZE;
+    }
+
+    [[nodiscard]] const uint8_t* frame(size_t index) const
+    {
+        return m_codes + index * FRAME_SIZE;
+    }
+
+    /**
+     * The encoded frames, e.g. to store them as file for view()
+     */
+    [[nodiscard]] const uint8_t* data() const
+    {
+        return m_codes;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    /** Only used by encode(), the data of a vector stays in place when it is moved */
+    std::vector<uint8_t> m_storage;
+    const uint8_t* m_codes { nullptr };
+    size_t m_size { 0 };
+    uint8_t m_payload_type { 0 };
+};
+
+/**
+ * Sends an Announcement as RTP stream, repeated until stop() is called
+ *
+ * The frames are paced by one asio::steady_timer, that expires at start + n * 20 ms, so the
+ * delay of the timer callbacks does not add up. Each datagram is the 12 byte RTP header in
+ * the tx buffer of the socket, followed by the frame sent directly from the announcement,
+ * so nothing is encoded, copied or allocated per frame.
+ */
+template <class SocketT>
+class AnnouncementPlayer
+{
+public:
+    using ClockT = asio::steady_timer::clock_type;
+
+    static constexpr std::chrono::milliseconds FRAME_DURATION { 20 };
+
+    AnnouncementPlayer(asio::io_context& io_context, SocketT& socket)
+        : m_timer(io_context)
+        , m_socket(socket)
+    {
+    }
+
+    /**
+     * \param[in] announcement Must outlive the player, nullptr disables the playback
+     */
+    void set_announcement(const Announcement* announcement)
+    {
+        stop();
+        m_announcement = announcement;
+    }
+
+    [[nodiscard]] bool has_announcement() const
+    {
+        return (m_announcement != nullptr) && (m_announcement->frame_count() > 0);
+    }
+
+    /**
+     * Payload type of the codec of the announcement, only valid if has_announcement()
+     */
+    [[nodiscard]] uint8_t get_payload_type() const
+    {
+        return m_announcement->get_payload_type();
+    }
+
+    /**
+     * Starts a new RTP stream with the first frame, a running playback is restarted
+     *
+     * \param[in] payload_type Payload type of the codec of the announcement, as negotiated with the peer
+     */
+    void start(uint8_t payload_type)
+    {
+        stop();
+        if (!has_announcement())
+        {
+            return;
+        }
+        m_payload_type = payload_type;
+        // random start values, as recommended by RFC 3550
+        m_ssrc = static_cast<uint32_t>(std::rand());
+        m_sequence_number = static_cast<uint16_t>(std::rand());
+        m_timestamp = static_cast<uint32_t>(std::rand());
+        m_frame = 0;
+        m_marker = true;
+        m_playing = true;
+        m_deadline = ClockT::now();
+        send_frame();
+        schedule();
+    }
+
+    void stop()
+    {
+        m_playing = false;
+        m_timer.cancel();
+    }
+
+    [[nodiscard]] bool is_playing() const
+    {
+        return m_playing;
+    }
+
+private:
+    /** After a longer stall, the missed frames are skipped instead of sent as burst */
+    static constexpr std::chrono::milliseconds MAX_LAG { 100 };
+
+    void schedule()
+    {
+        m_deadline += FRAME_DURATION;
+        m_timer.expires_at(m_deadline);
+        m_timer.async_wait([this](const asio::error_code& ec) {
+            if (ec || !m_playing)
+            {
+                return;
+            }
+            const auto now = ClockT::now();
+            if (now - m_deadline > MAX_LAG)
+            {
+                m_deadline = now;
+            }
+            send_frame();
+            schedule();
+        });
+    }
+
+    void send_frame()
+    {
+        const std::array<char, 12> header {
+            static_cast<char>(0x80),
+            static_cast<char>((m_marker ? 0x80 : 0x00) | m_payload_type),
+            static_cast<char>(m_sequence_number >> 8),
+            static_cast<char>(m_sequence_number),
+            static_cast<char>(m_timestamp >> 24),
+            static_cast<char>(m_timestamp >> 16),
+            static_cast<char>(m_timestamp >> 8),
+            static_cast<char>(m_timestamp),
+            static_cast<char>(m_ssrc >> 24),
+            static_cast<char>(m_ssrc >> 16),
+            static_cast<char>(m_ssrc >> 8),
+            static_cast<char>(m_ssrc),
+        };
+        m_socket.get_new_tx_buf() << std::string_view(header.data(), header.size());
+        m_socket.send_buffered_data(asio::buffer(m_announcement->frame(m_frame), Announcement::FRAME_SIZE));
+
+        m_marker = false;
+        m_sequence_number++;
+        m_timestamp += Announcement::FRAME_SIZE;
+        m_frame = (m_frame + 1) % m_announcement->frame_count();
+    }
+
+    asio::steady_timer m_timer;
+    SocketT& m_socket;
+    const Announcement* m_announcement { nullptr };
+    ClockT::time_point m_deadline;
+    size_t m_frame { 0 };
+    uint32_t m_ssrc { 0 };
+    uint32_t m_timestamp { 0 };
+    uint16_t m_sequence_number { 0 };
+    uint8_t m_payload_type { 0 };
+    bool m_marker { false };
+    bool m_playing { false };
+};
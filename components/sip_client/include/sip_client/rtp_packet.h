@@ -0,0 +1,178 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Header of a received RTP packet (RFC 3550)
+ *
+ * As with SipPacket, the payload is a view into the given input buffer, no copies are made.
+ * So the input buffer must outlive this packet and must not be modified afterwards.
+ */
+class RtpPacket
+{
+public:
+    RtpPacket(const char* input_buffer, size_t input_buffer_length)
+        : m_buffer(reinterpret_cast<const uint8_t*>(input_buffer))
+        , m_buffer_length(input_buffer_length)
+    {
+    }
+
+    /**
+     * Checks the fixed header and skips the CSRC list, the header extension and the padding
+     */
+    bool parse()
+    {
+        if (m_buffer_length < HEADER_SIZE)
+        {
+            return false;
+        }
+        if ((m_buffer[0] >> 6) != VERSION)
+        {
+            return false;
+        }
+        const bool padding = (m_buffer[0] & 0x20) != 0;
+        const bool extension = (m_buffer[0] & 0x10) != 0;
+        const size_t csrc_count = m_buffer[0] & 0x0F;
+
+        m_marker = (m_buffer[1] & 0x80) != 0;
+        m_payload_type = m_buffer[1] & 0x7F;
+        m_sequence_number = read16(m_buffer + 2);
+        m_timestamp = read32(m_buffer + 4);
+        m_ssrc = read32(m_buffer + 8);
+
+        size_t offset = HEADER_SIZE + 4 * csrc_count;
+        if (extension)
+        {
+            if (offset + 4 > m_buffer_length)
+            {
+                return false;
+            }
+            offset += 4 + 4 * static_cast<size_t>(read16(m_buffer + offset + 2));
+        }
+        size_t end = m_buffer_length;
+        if (padding)
+        {
+            const size_t padding_length = m_buffer[m_buffer_length - 1];
+            if (padding_length == 0)
+            {
+                return false;
+            }
+            end = (padding_length <= end) ? end - padding_length : 0;
+        }
+        if (offset > end)
+        {
+            return false;
+        }
+        m_payload = std::string_view(reinterpret_cast<const char*>(m_buffer + offset), end - offset);
+        return true;
+    }
+
+    [[nodiscard]] bool get_marker() const
+    {
+        return m_marker;
+    }
+
+    [[nodiscard]] uint8_t get_payload_type() const
+    {
+        return m_payload_type;
+    }
+
+    [[nodiscard]] uint16_t get_sequence_number() const
+    {
+        return m_sequence_number;
+    }
+
+    [[nodiscard]] uint32_t get_timestamp() const
+    {
+        return m_timestamp;
+    }
+
+    [[nodiscard]] uint32_t get_ssrc() const
+    {
+        return m_ssrc;
+    }
+
+    [[nodiscard]] std::string_view get_payload() const
+    {
+        return m_payload;
+    }
+
+private:
+    static uint16_t read16(const uint8_t* data)
+    {
+        return static_cast<uint16_t>((data[0] << 8) | data[1]);
+    }
+
+    static uint32_t read32(const uint8_t* data)
+    {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+    }
+
+    static constexpr size_t HEADER_SIZE = 12;
+    static constexpr uint8_t VERSION = 2;
+
+    const uint8_t* m_buffer;
+    const size_t m_buffer_length;
+
+    bool m_marker { false };
+    uint8_t m_payload_type { 0 };
+    uint16_t m_sequence_number { 0 };
+    uint32_t m_timestamp { 0 };
+    uint32_t m_ssrc { 0 };
+    std::string_view m_payload;
+};
+
+/**
+ * Payload of an RTP telephone-event packet (RFC 4733), e.g. a DTMF key
+ */
+struct TelephoneEvent
+{
+    /** 0-9, 10 for *, 11 for #, 12-15 for A-D */
+    uint8_t event { 0 };
+    bool end { false };
+    /** Power level in -dBm0 */
+    uint8_t volume { 0 };
+    /** Duration in timestamp units (1/8000 s), since the timestamp of the packet */
+    uint16_t duration { 0 };
+
+    static bool parse(std::string_view payload, TelephoneEvent& result)
+    {
+        if (payload.size() < 4)
+        {
+            return false;
+        }
+        const auto* data = reinterpret_cast<const uint8_t*>(payload.data());
+        result.event = data[0];
+        result.end = (data[1] & 0x80) != 0;
+        result.volume = data[1] & 0x3F;
+        result.duration = static_cast<uint16_t>((data[2] << 8) | data[3]);
+        return true;
+    }
+
+    /**
+     * Returns the DTMF key of the event, e.g. '5' or '#', ' ' for other events
+     */
+    [[nodiscard]] char dtmf_signal() const
+    {
+        constexpr std::string_view SIGNALS = "0123456789*#ABCD";
+        return (event < SIGNALS.size()) ? SIGNALS[event] : ' ';
+    }
+};
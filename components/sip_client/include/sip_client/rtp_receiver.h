@@ -0,0 +1,402 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "inplace_function.h"
+#include "rtp_packet.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/**
+ * Jitter buffer of one RTP stream (one SSRC), a ring of SLOTS frames indexed by the sequence number
+ *
+ * The payload is copied once into its slot, because the receive buffer is reused for the next
+ * datagram. Frames are played out in sequence order by pop(), after PREFILL frames are buffered.
+ */
+template <size_t SLOTS, size_t MAX_PAYLOAD>
+class JitterBuffer
+{
+    static_assert((SLOTS & (SLOTS - 1)) == 0, "SLOTS must be a power of two");
+
+public:
+    struct Frame
+    {
+        uint16_t sequence_number { 0 };
+        uint32_t timestamp { 0 };
+        uint8_t payload_type { 0 };
+        bool marker { false };
+        bool valid { false };
+        uint16_t size { 0 };
+        std::array<uint8_t, MAX_PAYLOAD> data {};
+
+        [[nodiscard]] std::string_view payload() const
+        {
+            return { reinterpret_cast<const char*>(data.data()), size };
+        }
+    };
+
+    struct Statistics
+    {
+        uint32_t received { 0 };
+        uint32_t duplicates { 0 };
+        /** Arrived after their frame was played out or skipped */
+        uint32_t late { 0 };
+        /** Missing when they were played out */
+        uint32_t lost { 0 };
+        uint32_t too_large { 0 };
+        /** Interarrival jitter in timestamp units (RFC 3550 A.8) */
+        uint32_t jitter { 0 };
+    };
+
+    /** Frames buffered before the play out starts, i.e. 40 ms with 20 ms frames */
+    static constexpr size_t PREFILL = SLOTS / 4;
+
+    void reset(uint32_t ssrc)
+    {
+        m_ssrc = ssrc;
+        m_started = false;
+        m_statistics = {};
+        m_has_transit = false;
+        m_jitter_scaled = 0;
+    }
+
+    /**
+     * Stores the frame of the packet
+     *
+     * \param[in] arrival Arrival time of the packet in timestamp units, for the jitter estimation
+     * \return false if the packet is dropped (duplicate, late or too large)
+     */
+    bool push(const RtpPacket& packet, uint32_t arrival)
+    {
+        const std::string_view payload = packet.get_payload();
+        if (payload.size() > MAX_PAYLOAD)
+        {
+            m_statistics.too_large++;
+            return false;
+        }
+        const uint16_t sequence_number = packet.get_sequence_number();
+        if (!m_started)
+        {
+            m_started = true;
+            restart(sequence_number);
+        }
+        update_jitter(packet.get_timestamp(), arrival);
+
+        const auto ahead = static_cast<int16_t>(sequence_number - m_next);
+        if ((ahead < -MAX_MISORDER) || (ahead >= static_cast<int16_t>(2 * SLOTS)))
+        {
+            // the source restarted or jumped, e.g. after a long pause
+            restart(sequence_number);
+        }
+        else if (ahead < 0)
+        {
+            m_statistics.late++;
+            return false;
+        }
+        // no room left for the frame, skip the oldest ones
+        while (static_cast<uint16_t>(sequence_number - m_next) >= SLOTS)
+        {
+            skip();
+        }
+
+        Frame& frame = m_frames[sequence_number & (SLOTS - 1)];
+        if (frame.valid && (frame.sequence_number == sequence_number))
+        {
+            m_statistics.duplicates++;
+            return false;
+        }
+        frame.sequence_number = sequence_number;
+        frame.timestamp = packet.get_timestamp();
+        frame.payload_type = packet.get_payload_type();
+        frame.marker = packet.get_marker();
+        frame.size = static_cast<uint16_t>(payload.size());
+        std::memcpy(frame.data.data(), payload.data(), payload.size());
+        frame.valid = true;
+        m_buffered++;
+        m_statistics.received++;
+        return true;
+    }
+
+    /**
+     * Returns the next frame in sequence order, one per packetization interval
+     *
+     * \return nullptr while prefilling after the start or an underrun, and for lost frames
+     *         (the caller conceals them). The frame stays valid until the next push().
+     */
+    const Frame* pop()
+    {
+        if (!m_playing)
+        {
+            if (m_buffered < PREFILL)
+            {
+                return nullptr;
+            }
+            m_playing = true;
+        }
+        if (m_buffered == 0)
+        {
+            m_playing = false;
+            return nullptr;
+        }
+        Frame& frame = m_frames[m_next & (SLOTS - 1)];
+        const bool present = frame.valid && (frame.sequence_number == m_next);
+        skip();
+        return present ? &frame : nullptr;
+    }
+
+    [[nodiscard]] uint32_t get_ssrc() const
+    {
+        return m_ssrc;
+    }
+
+    [[nodiscard]] size_t get_buffered() const
+    {
+        return m_buffered;
+    }
+
+    [[nodiscard]] const Statistics& get_statistics() const
+    {
+        return m_statistics;
+    }
+
+private:
+    /** Older packets are taken as a restart of the source (RFC 3550 A.1) */
+    static constexpr int16_t MAX_MISORDER = 100;
+
+    /**
+     * Drops all frames and continues at the sequence number
+     */
+    void restart(uint16_t sequence_number)
+    {
+        for (Frame& frame : m_frames)
+        {
+            frame.valid = false;
+        }
+        m_buffered = 0;
+        m_playing = false;
+        m_next = sequence_number;
+    }
+
+    /**
+     * Moves the play out position to the next sequence number, the current frame is released
+     */
+    void skip()
+    {
+        Frame& frame = m_frames[m_next & (SLOTS - 1)];
+        if (frame.valid && (frame.sequence_number == m_next))
+        {
+            frame.valid = false;
+            m_buffered--;
+        }
+        else
+        {
+            m_statistics.lost++;
+        }
+        m_next++;
+    }
+
+    void update_jitter(uint32_t timestamp, uint32_t arrival)
+    {
+        const uint32_t transit = arrival - timestamp;
+        if (m_has_transit)
+        {
+            const auto delta = static_cast<int32_t>(transit - m_transit);
+            const uint32_t distance = (delta < 0) ? static_cast<uint32_t>(-delta) : static_cast<uint32_t>(delta);
+            // J += (|D| - J) / 16, with 4 fractional bits
+            m_jitter_scaled += distance - ((m_jitter_scaled + 8) >> 4);
+            m_statistics.jitter = m_jitter_scaled >> 4;
+        }
+        m_transit = transit;
+        m_has_transit = true;
+    }
+
+    std::array<Frame, SLOTS> m_frames {};
+    uint32_t m_ssrc { 0 };
+    /** Sequence number of the next frame to play out */
+    uint16_t m_next { 0 };
+    bool m_started { false };
+    bool m_playing { false };
+    size_t m_buffered { 0 };
+    bool m_has_transit { false };
+    uint32_t m_transit { 0 };
+    uint32_t m_jitter_scaled { 0 };
+    Statistics m_statistics;
+};
+
+/**
+ * Receive path of the RTP socket
+ *
+ * Audio frames go into the jitter buffer of their SSRC, up to MAX_SOURCES streams are kept
+ * (e.g. when the PBX switches the source during a call), the least recently used one is replaced.
+ * Telephone events (RFC 4733) bypass the jitter buffer and are passed to the callback right away,
+ * so that a DTMF key is seen with the latency of one packet.
+ */
+template <size_t SLOTS = 8, size_t MAX_PAYLOAD = 160, size_t MAX_SOURCES = 2>
+class RtpReceiver
+{
+public:
+    using JitterBufferT = JitterBuffer<SLOTS, MAX_PAYLOAD>;
+    using TelephoneEventCallbackT = InplaceFunction<void(const RtpPacket&, const TelephoneEvent&)>;
+
+    static constexpr uint8_t DEFAULT_TELEPHONE_EVENT_PAYLOAD_TYPE = 101;
+
+    void set_telephone_event_callback(TelephoneEventCallbackT callback)
+    {
+        m_on_telephone_event = callback;
+    }
+
+    /**
+     * The dynamic payload type of telephone-event, as offered in the SDP (a=rtpmap:101 telephone-event/8000)
+     */
+    void set_telephone_event_payload_type(uint8_t payload_type)
+    {
+        m_telephone_event_payload_type = payload_type;
+    }
+
+    /**
+     * Handles a received datagram
+     *
+     * \param[in] arrival Arrival time in timestamp units (1/8000 s)
+     * \return false if it is not a valid RTP packet or the frame was dropped
+     */
+    bool rx(std::string_view data, uint32_t arrival)
+    {
+        RtpPacket packet(data.data(), data.size());
+        if (!packet.parse())
+        {
+            m_invalid++;
+            return false;
+        }
+        if (packet.get_payload_type() == m_telephone_event_payload_type)
+        {
+            TelephoneEvent event;
+            if (!TelephoneEvent::parse(packet.get_payload(), event))
+            {
+                m_invalid++;
+                return false;
+            }
+            if (m_on_telephone_event)
+            {
+                m_on_telephone_event(packet, event);
+            }
+            return true;
+        }
+        return stream(packet.get_ssrc()).push(packet, arrival);
+    }
+
+    /**
+     * Plays out the next frame of the most recently received stream, once per packetization interval
+     *
+     * \return nullptr for a missing frame, see JitterBuffer::pop()
+     */
+    const typename JitterBufferT::Frame* pop()
+    {
+        JitterBufferT* buffer = current();
+        return (buffer == nullptr) ? nullptr : buffer->pop();
+    }
+
+    /**
+     * Returns the jitter buffer of the SSRC or nullptr
+     */
+    JitterBufferT* find(uint32_t ssrc)
+    {
+        for (Source& source : m_sources)
+        {
+            if (source.used && (source.buffer.get_ssrc() == ssrc))
+            {
+                return &source.buffer;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Returns the jitter buffer of the most recently received stream or nullptr
+     */
+    JitterBufferT* current()
+    {
+        Source* result = nullptr;
+        for (Source& source : m_sources)
+        {
+            if (source.used && ((result == nullptr) || (source.last_used > result->last_used)))
+            {
+                result = &source;
+            }
+        }
+        return (result == nullptr) ? nullptr : &result->buffer;
+    }
+
+    /**
+     * Forgets all streams, e.g. at the end of a call
+     */
+    void reset()
+    {
+        for (Source& source : m_sources)
+        {
+            source.used = false;
+        }
+        m_invalid = 0;
+    }
+
+    /**
+     * Number of datagrams, that were not valid RTP packets
+     */
+    [[nodiscard]] uint32_t get_invalid() const
+    {
+        return m_invalid;
+    }
+
+private:
+    struct Source
+    {
+        JitterBufferT buffer;
+        uint32_t last_used { 0 };
+        bool used { false };
+    };
+
+    JitterBufferT& stream(uint32_t ssrc)
+    {
+        m_clock++;
+        Source* oldest = &m_sources[0];
+        for (Source& source : m_sources)
+        {
+            if (source.used && (source.buffer.get_ssrc() == ssrc))
+            {
+                source.last_used = m_clock;
+                return source.buffer;
+            }
+            if (!source.used || (oldest->used && (source.last_used < oldest->last_used)))
+            {
+                oldest = &source;
+            }
+        }
+        oldest->used = true;
+        oldest->last_used = m_clock;
+        oldest->buffer.reset(ssrc);
+        return oldest->buffer;
+    }
+
+    std::array<Source, MAX_SOURCES> m_sources {};
+    TelephoneEventCallbackT m_on_telephone_event;
+    uint8_t m_telephone_event_payload_type { DEFAULT_TELEPHONE_EVENT_PAYLOAD_TYPE };
+    uint32_t m_clock { 0 };
+    uint32_t m_invalid { 0 };
+};
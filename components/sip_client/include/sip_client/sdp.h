@@ -0,0 +1,565 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class SdpDirection
+{
+    SENDRECV,
+    SENDONLY,
+    RECVONLY,
+    INACTIVE
+};
+
+constexpr std::string_view sdp_direction_name(SdpDirection direction)
+{
+    switch (direction)
+    {
+    case SdpDirection::SENDONLY:
+        return "sendonly";
+    case SdpDirection::RECVONLY:
+        return "recvonly";
+    case SdpDirection::INACTIVE:
+        return "inactive";
+    case SdpDirection::SENDRECV:
+        break;
+    }
+    return "sendrecv";
+}
+
+/**
+ * Value of an a=rtpmap attribute, e.g. 101 telephone-event/8000
+ */
+struct SdpRtpMap
+{
+    uint8_t payload_type { 0 };
+    std::string_view encoding_name;
+    uint32_t clock_rate { 0 };
+    /** e.g. the channels, empty if none */
+    std::string_view parameters;
+};
+
+/**
+ * A media section, from its m= line up to the next one
+ *
+ * All views point into the parsed body. The attributes are not copied, rtpmap() and fmtp()
+ * look them up in the attribute lines of the section.
+ */
+struct SdpMedia
+{
+    static constexpr size_t MAX_FORMATS = 16;
+
+    /** e.g. audio */
+    std::string_view media;
+    uint16_t port { 0 };
+    /** e.g. RTP/AVP */
+    std::string_view protocol;
+    /** The format list as in the m= line, e.g. 0 8 101 */
+    std::string_view formats;
+    /** The numeric formats (RTP payload types) of the list, the ones beyond MAX_FORMATS are ignored */
+    std::array<uint8_t, MAX_FORMATS> payload_types {};
+    size_t payload_type_count { 0 };
+    /** Address of the c= line of the section, empty if the session one applies */
+    std::string_view connection_address;
+    /** The direction attribute of the section, otherwise the one of the session */
+    SdpDirection direction { SdpDirection::SENDRECV };
+    /** a=ptime, 0 if none */
+    uint16_t ptime { 0 };
+    /** All a= lines of the section */
+    std::string_view attributes;
+
+    /**
+     * Looks up the rtpmap of the payload type, for the static payload types PCMU and PCMA
+     * (RFC 3551) it is optional
+     */
+    bool rtpmap(uint8_t payload_type, SdpRtpMap& result) const;
+
+    /**
+     * Returns the parameters of the a=fmtp line of the payload type, e.g. 0-15, empty if none
+     */
+    [[nodiscard]] std::string_view fmtp(uint8_t payload_type) const;
+};
+
+/**
+ * Zero copy parser of a session description (RFC 4566)
+ *
+ * Like SipPacket, the parser only stores views into the body, so the body must outlive the
+ * session. The size is fixed, a session can be parsed on the stack for each received offer.
+ */
+class SdpSession
+{
+public:
+    static constexpr size_t MAX_MEDIA = 4;
+
+    bool parse(std::string_view body)
+    {
+        m_origin = {};
+        m_connection_address = {};
+        m_media_count = 0;
+        SdpDirection session_direction = SdpDirection::SENDRECV;
+        SdpMedia* media = nullptr;
+        bool has_version = false;
+
+        for (std::string_view rest = body; !rest.empty();)
+        {
+            const size_t line_end = rest.find('\n');
+            std::string_view line = rest.substr(0, line_end);
+            rest = (line_end == std::string_view::npos) ? std::string_view {} : rest.substr(line_end + 1);
+            if (!line.empty() && (line.back() == '\r'))
+            {
+                line.remove_suffix(1);
+            }
+            if ((line.size() < 2) || (line[1] != '='))
+            {
+                continue;
+            }
+            const std::string_view value = line.substr(2);
+            switch (line[0])
+            {
+            case 'v':
+                has_version = true;
+                break;
+            case 'o':
+                m_origin = value;
+                break;
+            case 'c':
+                (media == nullptr ? m_connection_address : media->connection_address) = parse_connection_address(value);
+                break;
+            case 'm':
+                if (m_media_count == MAX_MEDIA)
+                {
+                    // a partial session cannot be answered
+                    return false;
+                }
+                media = &m_media[m_media_count++];
+                *media = SdpMedia {};
+                media->direction = session_direction;
+                if (!parse_media(value, *media))
+                {
+                    return false;
+                }
+                break;
+            case 'a':
+                if (media == nullptr)
+                {
+                    parse_direction(value, session_direction);
+                }
+                else
+                {
+                    parse_media_attribute(line, value, *media);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        return has_version;
+    }
+
+    /** The value of the o= line */
+    [[nodiscard]] std::string_view get_origin() const
+    {
+        return m_origin;
+    }
+
+    [[nodiscard]] size_t media_count() const
+    {
+        return m_media_count;
+    }
+
+    [[nodiscard]] const SdpMedia& media(size_t index) const
+    {
+        return m_media[index];
+    }
+
+    /**
+     * The address to send the media to, from the c= line of the section or of the session
+     */
+    [[nodiscard]] std::string_view connection_address(const SdpMedia& media) const
+    {
+        return media.connection_address.empty() ? m_connection_address : media.connection_address;
+    }
+
+private:
+    /**
+     * Returns the address of "IN IP4 <address>[/<ttl>]", only IPv4 is supported
+     */
+    static std::string_view parse_connection_address(std::string_view value)
+    {
+        constexpr std::string_view IN_IP4 = "IN IP4 ";
+        if (value.substr(0, IN_IP4.size()) != IN_IP4)
+        {
+            return {};
+        }
+        const std::string_view address = value.substr(IN_IP4.size());
+        return address.substr(0, address.find('/'));
+    }
+
+    /**
+     * Parses "<media> <port>[/<count>] <protocol> <format>..."
+     */
+    static bool parse_media(std::string_view value, SdpMedia& media)
+    {
+        media.media = next_token(value);
+        const std::string_view port = next_token(value);
+        media.protocol = next_token(value);
+        media.formats = value;
+        if (media.media.empty() || media.protocol.empty() || !to_number(port.substr(0, port.find('/')), media.port))
+        {
+            return false;
+        }
+        while (!value.empty())
+        {
+            uint8_t payload_type = 0;
+            if (to_number(next_token(value), payload_type) && (payload_type < 128) && (media.payload_type_count < media.payload_types.size()))
+            {
+                media.payload_types[media.payload_type_count++] = payload_type;
+            }
+        }
+        return true;
+    }
+
+    static void parse_media_attribute(std::string_view line, std::string_view value, SdpMedia& media)
+    {
+        // the attribute lines of a section follow each other, the view grows up to the last one
+        media.attributes = media.attributes.empty() ? line : std::string_view(media.attributes.data(), static_cast<size_t>(line.data() + line.size() - media.attributes.data()));
+        constexpr std::string_view PTIME = "ptime:";
+        if (value.substr(0, PTIME.size()) == PTIME)
+        {
+            to_number(value.substr(PTIME.size()), media.ptime);
+            return;
+        }
+        parse_direction(value, media.direction);
+    }
+
+    static void parse_direction(std::string_view value, SdpDirection& direction)
+    {
+        for (const SdpDirection candidate : { SdpDirection::SENDRECV, SdpDirection::SENDONLY, SdpDirection::RECVONLY, SdpDirection::INACTIVE })
+        {
+            if (value == sdp_direction_name(candidate))
+            {
+                direction = candidate;
+                return;
+            }
+        }
+    }
+
+public:
+    /**
+     * Returns the text up to the next space and removes it (and the space) from the input
+     */
+    static std::string_view next_token(std::string_view& input)
+    {
+        const size_t end = input.find(' ');
+        const std::string_view token = input.substr(0, end);
+        input = (end == std::string_view::npos) ? std::string_view {} : input.substr(end + 1);
+        return token;
+    }
+
+    template <typename T>
+    static bool to_number(std::string_view input, T& result)
+    {
+        const auto [ptr, ec] = std::from_chars(input.data(), input.data() + input.size(), result);
+        return (ec == std::errc {}) && (ptr == input.data() + input.size()) && !input.empty();
+    }
+
+private:
+    std::string_view m_origin;
+    std::string_view m_connection_address;
+    std::array<SdpMedia, MAX_MEDIA> m_media {};
+    size_t m_media_count { 0 };
+};
+
+inline bool SdpMedia::rtpmap(uint8_t payload_type, SdpRtpMap& result) const
+{
+    constexpr std::string_view RTPMAP = "a=rtpmap:";
+    for (std::string_view rest = attributes; !rest.empty();)
+    {
+        const size_t line_end = rest.find('\n');
+        std::string_view line = rest.substr(0, line_end);
+        rest = (line_end == std::string_view::npos) ? std::string_view {} : rest.substr(line_end + 1);
+        if (line.substr(0, RTPMAP.size()) != RTPMAP)
+        {
+            continue;
+        }
+        if (line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        line.remove_prefix(RTPMAP.size());
+        uint8_t mapped = 0;
+        if (!SdpSession::to_number(SdpSession::next_token(line), mapped) || (mapped != payload_type))
+        {
+            continue;
+        }
+        // <encoding name>/<clock rate>[/<parameters>]
+        const size_t rate_start = line.find('/');
+        if (rate_start == std::string_view::npos)
+        {
+            return false;
+        }
+        const size_t rate_end = line.find('/', rate_start + 1);
+        result.payload_type = payload_type;
+        result.encoding_name = line.substr(0, rate_start);
+        result.parameters = (rate_end == std::string_view::npos) ? std::string_view {} : line.substr(rate_end + 1);
+        return SdpSession::to_number(line.substr(rate_start + 1, rate_end - rate_start - 1), result.clock_rate);
+    }
+    constexpr uint8_t PCMU = 0;
+    constexpr uint8_t PCMA = 8;
+    if ((payload_type == PCMU) || (payload_type == PCMA))
+    {
+        result = SdpRtpMap { payload_type, (payload_type == PCMU) ? "PCMU" : "PCMA", 8000, {} };
+        return true;
+    }
+    return false;
+}
+
+inline std::string_view SdpMedia::fmtp(uint8_t payload_type) const
+{
+    constexpr std::string_view FMTP = "a=fmtp:";
+    for (std::string_view rest = attributes; !rest.empty();)
+    {
+        const size_t line_end = rest.find('\n');
+        std::string_view line = rest.substr(0, line_end);
+        rest = (line_end == std::string_view::npos) ? std::string_view {} : rest.substr(line_end + 1);
+        if (line.substr(0, FMTP.size()) != FMTP)
+        {
+            continue;
+        }
+        if (line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        line.remove_prefix(FMTP.size());
+        uint8_t mapped = 0;
+        if (SdpSession::to_number(SdpSession::next_token(line), mapped) && (mapped == payload_type))
+        {
+            return line;
+        }
+    }
+    return {};
+}
+
+/**
+ * A codec supported by the client
+ */
+struct SdpCodec
+{
+    std::string_view encoding_name;
+    uint32_t clock_rate;
+    /** Payload type in the own offer */
+    uint8_t payload_type;
+    /** Parameters of the a=fmtp line, empty if none */
+    std::string_view fmtp;
+    /** Telephone events are only negotiated together with a voice codec */
+    bool event;
+};
+
+/**
+ * The codecs of the own offer (m=audio ... RTP/AVP 0 8 101), in the order of preference
+ */
+inline constexpr std::array<SdpCodec, 3> SDP_CODECS { {
+    { "PCMU", 8000, 0, {}, false },
+    { "PCMA", 8000, 8, {}, false },
+    { "telephone-event", 8000, 101, "0-15", true },
+} };
+
+/**
+ * Result of the offer/answer (RFC 3264) of the audio stream
+ *
+ * Nothing refers to the parsed session, so the stream can be kept for the whole call.
+ */
+struct SdpAudioStream
+{
+    static constexpr uint8_t NONE = 0xFF;
+
+    /** Index of the accepted media section */
+    size_t media_index { 0 };
+    /** RTP port of the peer */
+    uint16_t port { 0 };
+    /** Payload type of the peer for each of SDP_CODECS, NONE if it is not supported by the peer */
+    std::array<uint8_t, SDP_CODECS.size()> payload_types { NONE, NONE, NONE };
+    /** The own direction */
+    SdpDirection direction { SdpDirection::INACTIVE };
+
+    /**
+     * Selects the first RTP/AVP audio section with a voice codec in common with SDP_CODECS
+     *
+     * \param[in] send_audio Audio is sent, if the peer receives it
+     * \return false if no section can be accepted, e.g. to answer with 488 Not Acceptable Here
+     */
+    static bool negotiate(const SdpSession& session, bool send_audio, SdpAudioStream& result)
+    {
+        for (size_t i = 0; i < session.media_count(); i++)
+        {
+            result = SdpAudioStream {};
+            result.media_index = i;
+            if (select_codecs(session.media(i), result))
+            {
+                const SdpDirection remote = session.media(i).direction;
+                const bool sends = send_audio && ((remote == SdpDirection::SENDRECV) || (remote == SdpDirection::RECVONLY));
+                const bool receives = (remote == SdpDirection::SENDRECV) || (remote == SdpDirection::SENDONLY);
+                result.direction = sends ? (receives ? SdpDirection::SENDRECV : SdpDirection::SENDONLY) : (receives ? SdpDirection::RECVONLY : SdpDirection::INACTIVE);
+                result.port = session.media(i).port;
+                return true;
+            }
+        }
+        result = SdpAudioStream {};
+        return false;
+    }
+
+    /**
+     * Returns the payload type of the peer for the own one, e.g. 96 for telephone-event, or NONE
+     */
+    [[nodiscard]] uint8_t payload_type(uint8_t own_payload_type) const
+    {
+        for (size_t i = 0; i < SDP_CODECS.size(); i++)
+        {
+            if (SDP_CODECS[i].payload_type == own_payload_type)
+            {
+                return payload_types[i];
+            }
+        }
+        return NONE;
+    }
+
+    /**
+     * True if audio with the codec of the own payload type can be sent to the peer
+     */
+    [[nodiscard]] bool can_send(uint8_t own_payload_type) const
+    {
+        return ((direction == SdpDirection::SENDRECV) || (direction == SdpDirection::SENDONLY)) && (payload_type(own_payload_type) != NONE);
+    }
+
+    /**
+     * True if audio is received from the peer
+     */
+    [[nodiscard]] bool can_receive() const
+    {
+        return (direction == SdpDirection::SENDRECV) || (direction == SdpDirection::RECVONLY);
+    }
+
+    /**
+     * Writes the media sections of the answer to the offer, the session part is written by the caller
+     *
+     * The accepted section lists the common codecs with the payload types and in the order of the
+     * offer, all other sections are rejected with port 0 (RFC 3264 6).
+     */
+    template <typename BufferT>
+    void write_answer(const SdpSession& offer, uint16_t local_rtp_port, BufferT& out) const
+    {
+        for (size_t i = 0; i < offer.media_count(); i++)
+        {
+            const SdpMedia& media = offer.media(i);
+            if (i != media_index)
+            {
+                out << "m=" << media.media << " 0 " << media.protocol << " " << media.formats << "\r\n";
+                continue;
+            }
+            out << "m=audio " << local_rtp_port << " RTP/AVP";
+            for_each_codec(media, [&out](uint8_t payload_type, const SdpCodec& /*codec*/) {
+                out << " " << payload_type;
+            });
+            out << "\r\n";
+            for_each_codec(media, [&out](uint8_t payload_type, const SdpCodec& codec) {
+                out << "a=rtpmap:" << payload_type << " " << codec.encoding_name << "/" << codec.clock_rate << "\r\n";
+                if (!codec.fmtp.empty())
+                {
+                    out << "a=fmtp:" << payload_type << " " << codec.fmtp << "\r\n";
+                }
+            });
+            out << "a=ptime:20\r\n";
+            out << "a=" << sdp_direction_name(direction) << "\r\n";
+        }
+    }
+
+private:
+    /**
+     * Takes the first payload type of the section for each of SDP_CODECS
+     *
+     * \return true if a voice codec is among them
+     */
+    static bool select_codecs(const SdpMedia& media, SdpAudioStream& result)
+    {
+        if ((media.media != "audio") || (media.protocol != "RTP/AVP") || (media.port == 0))
+        {
+            return false;
+        }
+        bool has_voice = false;
+        for (size_t i = 0; i < media.payload_type_count; i++)
+        {
+            SdpRtpMap rtpmap;
+            if (!media.rtpmap(media.payload_types[i], rtpmap))
+            {
+                continue;
+            }
+            for (size_t codec = 0; codec < SDP_CODECS.size(); codec++)
+            {
+                if ((result.payload_types[codec] == NONE) && (rtpmap.clock_rate == SDP_CODECS[codec].clock_rate) && equals_ignore_case(rtpmap.encoding_name, SDP_CODECS[codec].encoding_name))
+                {
+                    result.payload_types[codec] = rtpmap.payload_type;
+                    has_voice = has_voice || !SDP_CODECS[codec].event;
+                    break;
+                }
+            }
+        }
+        return has_voice;
+    }
+
+    /**
+     * Calls the function for each selected payload type in the order of the section
+     */
+    template <typename FunctionT>
+    void for_each_codec(const SdpMedia& media, FunctionT function) const
+    {
+        for (size_t i = 0; i < media.payload_type_count; i++)
+        {
+            for (size_t codec = 0; codec < SDP_CODECS.size(); codec++)
+            {
+                if (payload_types[codec] == media.payload_types[i])
+                {
+                    function(media.payload_types[i], SDP_CODECS[codec]);
+                    break;
+                }
+            }
+        }
+    }
+
+    static bool equals_ignore_case(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            const auto lower = [](char c) {
+                return ((c >= 'A') && (c <= 'Z')) ? static_cast<char>(c - 'A' + 'a') : c;
+            };
+            if (lower(a[i]) != lower(b[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
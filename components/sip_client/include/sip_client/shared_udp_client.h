@@ -0,0 +1,402 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "asio_udp_client.h"
+#include "sip_packet.h"
+#include "sip_transaction_table.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+template <class SocketT>
+class SharedUdpClient;
+
+/**
+ * One udp socket, that is shared by the SharedUdpClient handles of several accounts
+ *
+ * There is one transport per io_context and local port. Received datagrams are routed
+ * to the account they belong to:
+ * 1. by the Call-ID, if the account sent a message with this Call-ID before
+ * 2. requests by the user of the To uri, if the account registered this user
+ * Datagrams that cannot be routed are dropped. The routing tables only store the hashes
+ * of the Call-IDs and users.
+ */
+template <class SocketT>
+class SharedUdpTransport
+{
+public:
+    using HandleT = SharedUdpClient<SocketT>;
+
+    SharedUdpTransport(asio::io_context& io_context, const std::string& server_ip, const std::string& server_port, uint16_t local_port)
+        : m_key { &io_context, local_port }
+        , m_socket(io_context, server_ip, server_port, local_port, [this](std::string_view data) {
+            route(data);
+        })
+        , m_server_ip(server_ip)
+    {
+    }
+
+    ~SharedUdpTransport()
+    {
+        m_socket.deinit();
+        registry().erase(m_key);
+    }
+
+    SharedUdpTransport(const SharedUdpTransport&) = delete;
+    SharedUdpTransport(SharedUdpTransport&&) = delete;
+
+    SharedUdpTransport& operator=(const SharedUdpTransport&) = delete;
+    SharedUdpTransport& operator=(SharedUdpTransport&&) = delete;
+
+    /**
+     * Returns the transport for the local port, it is created by the first account
+     *
+     * \param[in] server_ip Only used when the transport is created, all accounts use the same server
+     */
+    static std::shared_ptr<SharedUdpTransport> acquire(asio::io_context& io_context, const std::string& server_ip, const std::string& server_port, uint16_t local_port)
+    {
+        std::weak_ptr<SharedUdpTransport>& entry = registry()[Key { &io_context, local_port }];
+        std::shared_ptr<SharedUdpTransport> transport = entry.lock();
+        if (!transport)
+        {
+            transport = std::make_shared<SharedUdpTransport>(io_context, server_ip, server_port, local_port);
+            entry = transport;
+        }
+        return transport;
+    }
+
+    SocketT& socket()
+    {
+        return m_socket;
+    }
+
+    /**
+     * Opens the socket for the first attached account
+     *
+     * The send backlog of the socket grows with the number of attached accounts, so that
+     * e.g. their re-registrations and replies can be queued at the same time.
+     */
+    bool attach()
+    {
+        if (!m_socket.is_initialized() && !m_socket.init())
+        {
+            return false;
+        }
+        m_attached++;
+        m_socket.set_tx_backlog_limit(tx_backlog_limit());
+        return true;
+    }
+
+    /**
+     * Closes the socket after the last account was detached
+     */
+    void detach()
+    {
+        if (m_attached == 0)
+        {
+            return;
+        }
+        if (--m_attached == 0)
+        {
+            m_socket.deinit();
+        }
+        m_socket.set_tx_backlog_limit(tx_backlog_limit());
+    }
+
+    /**
+     * Changes the server ip for all accounts and reopens the socket, if it was open
+     */
+    void set_server_ip(const std::string& server_ip)
+    {
+        if (server_ip == m_server_ip)
+        {
+            return;
+        }
+        m_server_ip = server_ip;
+        const bool reopen = m_socket.is_initialized();
+        m_socket.set_server_ip(server_ip);
+        if (reopen)
+        {
+            m_socket.init();
+        }
+    }
+
+    void add_call_id(uint64_t call_id_hash, HandleT* handle)
+    {
+        m_call_ids[call_id_hash] = handle;
+    }
+
+    void remove_call_id(uint64_t call_id_hash, const HandleT* handle)
+    {
+        remove_route(m_call_ids, call_id_hash, handle);
+    }
+
+    void add_user(uint64_t user_hash, HandleT* handle)
+    {
+        m_users[user_hash] = handle;
+    }
+
+    void remove_user(uint64_t user_hash, const HandleT* handle)
+    {
+        remove_route(m_users, user_hash, handle);
+    }
+
+    /**
+     * Returns the user of a sip uri inside of a header value, e.g. 620 for "<sip:620@192.168.179.1>"
+     */
+    static std::string_view uri_user(std::string_view value)
+    {
+        const size_t start = value.find("sip:");
+        if (start == std::string_view::npos)
+        {
+            return {};
+        }
+        value.remove_prefix(start + 4);
+        return value.substr(0, value.find_first_of("@;>"));
+    }
+
+private:
+    using Key = std::pair<asio::io_context*, uint16_t>;
+    using RoutesT = std::unordered_map<uint64_t, HandleT*>;
+
+    static std::map<Key, std::weak_ptr<SharedUdpTransport>>& registry()
+    {
+        static std::map<Key, std::weak_ptr<SharedUdpTransport>> transports;
+        return transports;
+    }
+
+    static void remove_route(RoutesT& routes, uint64_t key, const HandleT* handle)
+    {
+        const auto it = routes.find(key);
+        if ((it != routes.end()) && (it->second == handle))
+        {
+            routes.erase(it);
+        }
+    }
+
+    void route(std::string_view data)
+    {
+        SipPacket packet(data.data(), data.size());
+        if (!packet.parse())
+        {
+            ESP_LOGD(TAG, "Dropping datagram, that is not a sip message");
+            return;
+        }
+
+        HandleT* handle = find(m_call_ids, sip_key(packet.get_call_id()));
+        if ((handle == nullptr) && (packet.get_status() == SipPacket::Status::UNKNOWN))
+        {
+            handle = find(m_users, sip_key(uri_user(packet.get_to())));
+        }
+        if (handle == nullptr)
+        {
+            ESP_LOGD(TAG, "Dropping sip message for unknown Call-ID %.*s", static_cast<int>(packet.get_call_id().size()), packet.get_call_id().data());
+            return;
+        }
+        handle->deliver(data);
+    }
+
+    static HandleT* find(const RoutesT& routes, uint64_t key)
+    {
+        const auto it = routes.find(key);
+        return (it == routes.end()) ? nullptr : it->second;
+    }
+
+    [[nodiscard]] size_t tx_backlog_limit() const
+    {
+        return std::max<size_t>(TX_BACKLOG_LIMIT, m_attached * TX_BACKLOG_PER_ACCOUNT);
+    }
+
+    /** A request, a retransmission and the replies to the other party, that are queued at the same time */
+    static constexpr size_t TX_BACKLOG_PER_ACCOUNT = 4;
+
+    const Key m_key;
+    SocketT m_socket;
+    std::string m_server_ip;
+    size_t m_attached { 0 };
+    RoutesT m_call_ids;
+    RoutesT m_users;
+
+    static constexpr const char* TAG = "SharedUdp";
+};
+
+/**
+ * Per account handle to a SharedUdpTransport, used as SocketT of the SipClient
+ *
+ * All accounts with the same io_context and local port share one socket of type SocketT
+ * (e.g. AsioUdpClient). The handle learns the routing information from the messages sent
+ * by its account: the user from the REGISTER requests and the Call-IDs of the last
+ * CALL_ID_HISTORY sent messages.
+ *
+ * The handle itself is small, so the memory per account is dominated by the sip client state.
+ */
+template <class SocketT>
+class SharedUdpClient
+{
+    using TransportT = SharedUdpTransport<SocketT>;
+
+public:
+    SharedUdpClient(asio::io_context& io_context, const std::string& server_ip, const std::string& server_port, uint16_t local_port, RxCallbackT on_received)
+        : m_transport(TransportT::acquire(io_context, server_ip, server_port, local_port))
+        , m_on_received { on_received }
+    {
+    }
+
+    ~SharedUdpClient()
+    {
+        deinit();
+        for (const uint64_t call_id : m_call_ids)
+        {
+            m_transport->remove_call_id(call_id, this);
+        }
+        m_transport->remove_user(m_user, this);
+    }
+
+    SharedUdpClient(const SharedUdpClient&) = delete;
+    SharedUdpClient(SharedUdpClient&&) = delete;
+
+    SharedUdpClient& operator=(const SharedUdpClient&) = delete;
+    SharedUdpClient& operator=(SharedUdpClient&&) = delete;
+
+    void set_server_ip(const std::string& server_ip)
+    {
+        m_transport->set_server_ip(server_ip);
+    }
+
+    /**
+     * Refused, the destination of the socket would change for all accounts
+     *
+     * Received datagrams are routed as sip messages, so a shared socket cannot carry rtp anyway.
+     */
+    bool set_destination(std::string_view ip, uint16_t port)
+    {
+        ESP_LOGW(TAG, "Not sending to %.*s:%d, the socket is shared by all accounts", static_cast<int>(ip.size()), ip.data(), port);
+        return false;
+    }
+
+    void deinit()
+    {
+        if (!m_initialized)
+        {
+            return;
+        }
+        m_initialized = false;
+        m_transport->detach();
+    }
+
+    bool init()
+    {
+        if (m_initialized)
+        {
+            ESP_LOGW(TAG, "Socket already initialized");
+            return false;
+        }
+        m_initialized = m_transport->attach();
+        return m_initialized;
+    }
+
+    [[nodiscard]] bool is_initialized() const
+    {
+        return m_initialized;
+    }
+
+    TxBufferT& get_new_tx_buf()
+    {
+        m_tx_buffer = &m_transport->socket().get_new_tx_buf();
+        return *m_tx_buffer;
+    }
+
+    template <typename... Fragments>
+    bool send_buffered_data(const Fragments&... body)
+    {
+        if (m_tx_buffer != nullptr)
+        {
+            learn_routes(std::string_view(m_tx_buffer->data(), m_tx_buffer->size()));
+        }
+        return m_transport->socket().send_buffered_data(body...);
+    }
+
+    /**
+     * Called by the transport for each datagram routed to this account
+     */
+    void deliver(std::string_view data)
+    {
+        if (m_initialized && m_on_received)
+        {
+            m_on_received(data);
+        }
+    }
+
+private:
+    void learn_routes(std::string_view message)
+    {
+        const uint64_t call_id = sip_key(header_value(message, "\r\nCall-ID: "));
+        if (std::find(m_call_ids.begin(), m_call_ids.end(), call_id) == m_call_ids.end())
+        {
+            if (m_call_ids[m_next_call_id] != 0)
+            {
+                m_transport->remove_call_id(m_call_ids[m_next_call_id], this);
+            }
+            m_call_ids[m_next_call_id] = call_id;
+            m_next_call_id = (m_next_call_id + 1) % m_call_ids.size();
+            m_transport->add_call_id(call_id, this);
+        }
+
+        if (message.substr(0, REGISTER.size()) == REGISTER)
+        {
+            const uint64_t user = sip_key(TransportT::uri_user(header_value(message, "\r\nTo: ")));
+            if (user != m_user)
+            {
+                m_transport->remove_user(m_user, this);
+                m_user = user;
+                m_transport->add_user(m_user, this);
+            }
+        }
+    }
+
+    static std::string_view header_value(std::string_view message, std::string_view header)
+    {
+        const size_t start = message.find(header);
+        if (start == std::string_view::npos)
+        {
+            return {};
+        }
+        message.remove_prefix(start + header.size());
+        return message.substr(0, message.find("\r\n"));
+    }
+
+    static constexpr size_t CALL_ID_HISTORY = 4;
+
+    std::shared_ptr<TransportT> m_transport;
+    RxCallbackT m_on_received;
+    TxBufferT* m_tx_buffer { nullptr };
+    std::array<uint64_t, CALL_ID_HISTORY> m_call_ids {};
+    size_t m_next_call_id { 0 };
+    uint64_t m_user { 0 };
+    bool m_initialized { false };
+
+    static constexpr std::string_view REGISTER = "REGISTER ";
+    static constexpr const char* TAG = "SharedUdp";
+};
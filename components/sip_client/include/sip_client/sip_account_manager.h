@@ -0,0 +1,137 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "shared_udp_client.h"
+#include "sip_client.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Many sip accounts on one io_context
+ *
+ * All accounts register at the same server and share one sip socket and one rtp socket
+ * of type SocketT (see SharedUdpClient). Incoming messages are routed to the account
+ * by Call-ID or by the user.
+ */
+template <class SocketT, class Md5T, class Sha256T = void, class LoggerT = Logger>
+class SipAccountManager
+{
+public:
+    using SipClientT = SipClient<SharedUdpClient<SocketT>, Md5T, Sha256T, LoggerT>;
+
+    /**
+     * \param[in] register_interval Delay between the start of two accounts in init(),
+     *                              so that the registrations do not overflow the send queue
+     */
+    SipAccountManager(asio::io_context& io_context, std::string server_ip, std::string server_port, std::string my_ip,
+        std::chrono::milliseconds register_interval = std::chrono::milliseconds(10),
+        uint16_t local_port = SipClientT::DEFAULT_LOCAL_PORT, uint16_t local_rtp_port = SipClientT::DEFAULT_LOCAL_RTP_PORT)
+        : m_io_context(io_context)
+        , m_server_ip(std::move(server_ip))
+        , m_server_port(std::move(server_port))
+        , m_my_ip(std::move(my_ip))
+        , m_register_interval(register_interval)
+        , m_local_port(local_port)
+        , m_local_rtp_port(local_rtp_port)
+        , m_init_timer(io_context)
+    {
+    }
+
+    SipAccountManager(const SipAccountManager&) = delete;
+    SipAccountManager(SipAccountManager&&) = delete;
+
+    SipAccountManager& operator=(const SipAccountManager&) = delete;
+    SipAccountManager& operator=(SipAccountManager&&) = delete;
+
+    SipClientT& add_account(const std::string& user, const std::string& pwd)
+    {
+        m_accounts.push_back(std::make_unique<SipClientT>(m_io_context, user, pwd, m_server_ip, m_server_port, m_my_ip, m_local_port, m_local_rtp_port));
+        return *m_accounts.back();
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_accounts.size();
+    }
+
+    SipClientT& account(size_t index)
+    {
+        return *m_accounts[index];
+    }
+
+    /**
+     * Starts all accounts that are not started yet, one every register_interval
+     */
+    void init()
+    {
+        m_init_timer.cancel();
+        init_from(0);
+    }
+
+    void deinit()
+    {
+        m_init_timer.cancel();
+        for (auto& account : m_accounts)
+        {
+            account->deinit();
+        }
+    }
+
+private:
+    void init_from(size_t index)
+    {
+        for (; index < m_accounts.size(); index++)
+        {
+            if (m_accounts[index]->is_initialized())
+            {
+                continue;
+            }
+            if (!m_accounts[index]->init())
+            {
+                ESP_LOGE(TAG, "Failed to init account %d", static_cast<int>(index));
+            }
+            if (m_register_interval.count() > 0)
+            {
+                m_init_timer.expires_after(m_register_interval);
+                m_init_timer.async_wait([this, index](const asio::error_code& ec) {
+                    if (!ec)
+                    {
+                        init_from(index + 1);
+                    }
+                });
+                return;
+            }
+        }
+    }
+
+    asio::io_context& m_io_context;
+    const std::string m_server_ip;
+    const std::string m_server_port;
+    const std::string m_my_ip;
+    const std::chrono::milliseconds m_register_interval;
+    const uint16_t m_local_port;
+    const uint16_t m_local_rtp_port;
+
+    std::vector<std::unique_ptr<SipClientT>> m_accounts;
+    asio::steady_timer m_init_timer;
+
+    static constexpr const char* TAG = "SipAccounts";
+};
@@ -24,19 +24,31 @@
 #include <cstdlib>
 #include <functional>
 #include <string>
+#include <string_view>
 
-template <class SocketT, class Md5T>
+/**
+ * \tparam Sha256T Optional SHA-256 digest backend, see SipClientInt
+ * \tparam LoggerT Logger of the state machine: Logger (text), TraceLogger<N> or NoLogger, see sip_sml_logger.h
+ */
+template <class SocketT, class Md5T, class Sha256T = void, class LoggerT = Logger>
 class SipClient
 {
 private:
-    using SipClientT = SipClient<SocketT, Md5T>;
-    using SipClientInternal = SipClientInt<SocketT, Md5T, sip_states, SipClientT>;
-    using SmlSmT = sml::sm<sip_states<SipClientInternal>, sml::logger<Logger>>;
+    using SipClientT = SipClient<SocketT, Md5T, Sha256T, LoggerT>;
+    using SipClientInternal = SipClientInt<SocketT, Md5T, sip_states, SipClientT, Sha256T, LoggerT>;
+    using SmlSmT = sml::sm<sip_states<SipClientInternal>, sml::logger<LoggerT>>;
 
 public:
-    SipClient(asio::io_context& io_context, const std::string& user, const std::string& pwd, const std::string& server_ip, const std::string& server_port, const std::string& my_ip)
+    static constexpr uint16_t DEFAULT_LOCAL_PORT = SipClientInternal::DEFAULT_LOCAL_PORT;
+    static constexpr uint16_t DEFAULT_LOCAL_RTP_PORT = SipClientInternal::DEFAULT_LOCAL_RTP_PORT;
+
+    /**
+     * \param[in] local_port Local sip port, accounts using SharedUdpClient on the same port share one socket
+     * \param[in] local_rtp_port Local rtp port announced in the sdp
+     */
+    SipClient(asio::io_context& io_context, const std::string& user, const std::string& pwd, const std::string& server_ip, const std::string& server_port, const std::string& my_ip, uint16_t local_port = DEFAULT_LOCAL_PORT, uint16_t local_rtp_port = DEFAULT_LOCAL_RTP_PORT)
         : m_sip {
-            io_context, user, pwd, server_ip, server_port, my_ip, m_sm, *this
+            io_context, user, pwd, server_ip, server_port, my_ip, m_sm, *this, local_port, local_rtp_port
         }
         , m_sm { m_sip, m_logger }
     {
@@ -78,6 +90,30 @@ public:
         m_sip.set_event_handler(handler);
     }
 
+    /**
+     * Plays the announcement to the other party of each established call, until it hangs up
+     *
+     * The sdp offers a=sendrecv instead of a=recvonly while an announcement is set. It is only
+     * played, if the codec of the announcement was negotiated with the other party.
+     *
+     * \param[in] announcement Must outlive the client, nullptr disables the playback
+     */
+    void set_announcement(const Announcement* announcement)
+    {
+        m_sip.set_announcement(announcement);
+    }
+
+    /**
+     * Receives the audio of the other party during a call, one frame every 20 ms from the jitter buffer
+     *
+     * The handler gets the encoded payload and its RTP payload type (e.g. 0 for PCMU, 8 for PCMA,
+     * see g711.h). The payload is empty for a lost frame, which the handler is expected to conceal.
+     */
+    void set_audio_handler(std::function<void(SipClientT&, std::string_view payload, uint8_t payload_type)> handler)
+    {
+        m_sip.set_audio_handler(handler);
+    }
+
     /**
      * Initiate a call async
      *
@@ -99,8 +135,16 @@ public:
         m_sip.deinit();
     }
 
+    /**
+     * The logger of the state machine, e.g. to dump() the trace of a TraceLogger
+     */
+    [[nodiscard]] const LoggerT& get_sm_logger() const
+    {
+        return m_logger;
+    }
+
 private:
     SipClientInternal m_sip;
-    Logger m_logger {};
+    LoggerT m_logger {};
     SmlSmT m_sm;
 };
@@ -31,6 +31,9 @@ struct SipClientEvent
         UNKNOWN,
         CALL_DECLINED,
         TARGET_BUSY,
+        NO_RESPONSE,
+        /** Any other final error response to the INVITE, e.g. 404 Not Found */
+        CALL_FAILED,
     };
 
     Event event;
@@ -16,28 +16,69 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <type_traits>
 #include <utility>
 
+#include "digest.h"
+#include "dtmf_detector.h"
+#include "rtp_announcement.h"
+#include "rtp_receiver.h"
+#include "sdp.h"
 #include "sip_client_event.h"
+#include "sip_message_templates.h"
 #include "sip_packet.h"
+#include "sip_rx_dispatch.h"
 #include "sip_sml_events.h"
 #include "sip_sml_logger.h"
+#include "sip_transaction_table.h"
+#include "timer_wheel.h"
 
 #include "boost/sml.hpp"
 
 namespace sml = boost::sml;
 
-template <class SocketT, class Md5T, template <typename> typename SmT, class SipClientT>
+/**
+ * The socket type for the rtp of a sip client with the sip socket SocketT: SocketT::RtpSocketT, if it is defined
+ */
+template <class SocketT, typename = void>
+struct RtpSocketOf
+{
+    using type = SocketT;
+};
+
+template <class SocketT>
+struct RtpSocketOf<SocketT, std::void_t<typename SocketT::RtpSocketT>>
+{
+    using type = typename SocketT::RtpSocketT;
+};
+
+/**
+ * \tparam Md5T Digest backend for MD5, e.g. MbedtlsMd5
+ * \tparam Sha256T Digest backend for SHA-256 (RFC 8760), e.g. MbedtlsSha256, void to only support MD5
+ * \tparam LoggerT Logger of the state machine, see sip_sml_logger.h
+ */
+template <class SocketT, class Md5T, template <typename> typename SmT, class SipClientT, class Sha256T = void, class LoggerT = Logger>
 class SipClientInt
 {
-    using SmlSmT = sml::sm<SmT<SipClientInt<SocketT, Md5T, SmT, SipClientT>>, sml::logger<Logger>>;
+    using SmlSmT = sml::sm<SmT<SipClientInt<SocketT, Md5T, SmT, SipClientT, Sha256T, LoggerT>>, sml::logger<LoggerT>>;
+    using RtpSocketT = typename RtpSocketOf<SocketT>::type;
 
 public:
-    SipClientInt(asio::io_context& io_context, const std::string& user, std::string pwd, const std::string& server_ip, const std::string& server_port, std::string my_ip, SmlSmT& sm, SipClientT& sip_client)
-        : m_socket(io_context, server_ip, server_port, LOCAL_PORT, [this](std::string data) {
+    static constexpr uint16_t DEFAULT_LOCAL_PORT = 5060;
+    static constexpr uint16_t DEFAULT_LOCAL_RTP_PORT = 7078;
+
+    SipClientInt(asio::io_context& io_context, const std::string& user, std::string pwd, const std::string& server_ip, const std::string& server_port, std::string my_ip, SmlSmT& sm, SipClientT& sip_client, uint16_t local_port = DEFAULT_LOCAL_PORT, uint16_t local_rtp_port = DEFAULT_LOCAL_RTP_PORT)
+        : m_socket(io_context, server_ip, server_port, local_port, [this](std::string_view data) {
             rx(data);
         })
-        , m_rtp_socket(io_context, server_ip, "7078", LOCAL_RTP_PORT, [](const std::string& /*unused*/) {
+        , m_rtp_socket(io_context, server_ip, "7078", local_rtp_port, [this](std::string_view data) {
+            rx_rtp(data);
         })
         , m_server_ip(server_ip)
         , m_user(user)
@@ -45,6 +86,7 @@ public:
         , m_my_ip(std::move(my_ip))
         , m_uri("sip:" + server_ip)
         , m_to_uri("sip:" + user + "@" + server_ip)
+        , m_timer_wheel(TimerWheel::acquire(io_context))
         , m_sip_sequence_number(std::rand() % 2147483647)
         , m_call_id(std::rand() % 2147483647)
         , m_tag(std::rand() % 2147483647)
@@ -52,11 +94,11 @@ public:
         , m_caller_display(m_user)
         , m_sm(sm)
         , m_io_context(io_context)
-        , m_timer(io_context)
-        , m_command_timeout_timer(io_context)
-        , m_reregister_timer(io_context)
         , m_sip_client(sip_client)
+        , m_local_port(local_port)
+        , m_local_rtp_port(local_rtp_port)
     {
+        update_templates();
     }
 
     bool init()
@@ -87,11 +129,15 @@ public:
         m_rtp_socket.set_server_ip(server_ip);
         m_uri = "sip:" + server_ip;
         m_to_uri = "sip:" + m_user + "@" + server_ip;
+        m_register_auth = {};
+        m_invite_auth = {};
+        update_templates();
     }
 
     void set_my_ip(const std::string& my_ip)
     {
         m_my_ip = my_ip;
+        update_templates();
     }
 
     void set_credentials(const std::string& user, const std::string& password)
@@ -99,6 +145,10 @@ public:
         m_user = user;
         m_pwd = password;
         m_to_uri = "sip:" + m_user + "@" + m_server_ip;
+        m_ha1_valid = false;
+        m_register_auth = {};
+        m_invite_auth = {};
+        update_templates();
     }
 
     void set_event_handler(std::function<void(SipClientT&, const SipClientEvent&)> handler)
@@ -106,6 +156,21 @@ public:
         m_event_handler = handler;
     }
 
+    void set_announcement(const Announcement* announcement)
+    {
+        m_announcement = announcement;
+        if (m_media != nullptr)
+        {
+            m_media->announcement_player.set_announcement(announcement);
+        }
+        update_templates();
+    }
+
+    void set_audio_handler(std::function<void(SipClientT&, std::string_view, uint8_t)> handler)
+    {
+        m_audio_handler = handler;
+    }
+
     /**
      * Initiate a call async
      *
@@ -131,6 +196,11 @@ public:
     void deinit()
     {
         ESP_LOGI(TAG, "Deinit");
+        m_timer.cancel();
+        m_reregister_timer.cancel();
+        m_media.reset();
+        clear_transactions();
+        m_dialogs.clear();
         m_socket.deinit();
         m_rtp_socket.deinit();
     }
@@ -138,9 +208,10 @@ public:
     // send initial register request
     void register_unauth()
     {
-        // sending REGISTER without auth
+        // sending REGISTER without auth, or with the nonce of the last registration if it can be reused
         m_tag = std::rand() % 2147483647;
         m_branch = std::rand() % 2147483647;
+        reuse_auth(REGISTER, m_templates.register_uri(), m_register_auth);
         send_sip_register();
         m_tag = std::rand() % 2147483647;
         m_branch = std::rand() % 2147483647;
@@ -151,7 +222,7 @@ public:
     {
         m_sip_sequence_number++;
         // sending REGISTER with auth
-        compute_auth_response("REGISTER", "sip:" + m_server_ip);
+        compute_auth_response(REGISTER, m_templates.register_uri(), m_register_auth);
         send_sip_register();
     }
 
@@ -161,23 +232,14 @@ public:
         {
             register_expires = 3600;
         }
-        m_reregister_timer.expires_after(asio::chrono::seconds(register_expires / 2));
-
-        m_reregister_timer.async_wait([this](const asio::error_code& ec) {
-            if (!ec)
-            {
-                this->m_sm.process_event(ev_reregister {});
-            }
+        m_timer_wheel->start(m_reregister_timer, asio::chrono::seconds(register_expires / 2), [this]() {
+            this->m_sm.process_event(ev_reregister {});
         });
     }
 
     void is_registered()
     {
         m_sip_sequence_number++;
-        m_nonce = "";
-        m_realm = "";
-        m_proxy_auth = false;
-        m_response = "";
         ESP_LOGI(TAG, "OK :)");
         m_uri = "sip:**613@" + m_server_ip;
         m_to_uri = "sip:**613@" + m_server_ip;
@@ -193,7 +255,7 @@ public:
         // or sending INVITE with auth
         m_branch = std::rand() % 2147483647;
         m_sip_sequence_number++;
-        compute_auth_response("INVITE", m_uri);
+        compute_auth_response(INVITE, m_uri, m_invite_auth);
         send_sip_invite();
     }
 
@@ -202,13 +264,21 @@ public:
         m_sip_sequence_number++;
         m_sdp_session_id = static_cast<uint32_t>(std::rand());
         m_branch = std::rand() % 2147483647;
+        // authorize with the nonce of the last call, to save the round trip of the 407
+        reuse_auth(INVITE, m_uri, m_invite_auth);
         send_sip_invite();
     }
 
     void request_call(const ev_request_call& event)
     {
         ESP_LOGI(TAG, "Request to call %s...", event.local_number.c_str());
+        // only one call at a time, the dialogs of older calls are stale, e.g. after a lost BYE
+        m_dialogs.clear();
         m_call_id = std::rand() % 2147483647;
+        m_to_contact.clear();
+        m_to_tag.clear();
+        m_record_route.fill({});
+        start_call_media();
         m_uri = "sip:" + event.local_number + "@" + m_server_ip;
         m_to_uri = "sip:" + event.local_number + "@" + m_server_ip;
         m_caller_display = event.caller_display;
@@ -225,9 +295,31 @@ public:
         // send_sip_bye();
     }
 
-    void handle_invite(const ev_rx_invite& /*unused*/)
+    /**
+     * Accepts a received INVITE, only called in the states that take a new call
+     */
+    void handle_invite(const ev_rx_invite& event)
     {
-        // received an invite, answered it already with ok, so new call is established, because someone called us
+        const SipPacket& packet = *event.packet;
+        // only one call at a time, the dialogs of older calls are stale, e.g. after a lost BYE
+        m_dialogs.clear();
+        m_dialogs.insert(sip_key(packet.get_call_id()), Dialog { false });
+        start_call_media();
+        if (event.offer != nullptr)
+        {
+            m_media->audio_stream = *event.audio_stream;
+            apply_audio_stream(*event.offer);
+        }
+        else
+        {
+            // the answer to the own offer would be in the ACK, which is not parsed
+            ESP_LOGI(TAG, "Invite without sdp offer, not sending audio");
+        }
+        m_media->sdp_answer << event.answer;
+        send_sip_invite_ok(packet);
+        start_media_timer();
+        start_playout();
+        start_announcement();
         if (m_event_handler)
         {
             m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::CALL_START });
@@ -238,6 +330,9 @@ public:
     {
         // ack to ok after invite
         send_sip_ack();
+        start_media_timer();
+        start_playout();
+        start_announcement();
         if (m_event_handler)
         {
             m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::CALL_START });
@@ -246,6 +341,8 @@ public:
 
     void call_cancelled()
     {
+        end_dialog(own_dialog_key());
+        m_media.reset();
         if (m_event_handler)
         {
             m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::CALL_CANCELLED });
@@ -256,8 +353,30 @@ public:
         m_sip_sequence_number++;
     }
 
+    void call_timed_out()
+    {
+        end_dialog(own_dialog_key());
+        m_media.reset();
+        // a proceeding INVITE has no timeout, drop it together with the timed out CANCEL
+        m_transactions.for_each([this](uint64_t key, Transaction& transaction) {
+            if (transaction.method == INVITE)
+            {
+                erase_transaction(key, transaction);
+            }
+        });
+        if (m_event_handler)
+        {
+            m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::CALL_CANCELLED, ' ', 0, SipClientEvent::CancelReason::NO_RESPONSE });
+        }
+        m_tag = std::rand() % 2147483647;
+        m_branch = std::rand() % 2147483647;
+        m_sip_sequence_number++;
+    }
+
     void call_declined(const ev_486_busy_here& /*unused*/)
     {
+        end_dialog(own_dialog_key());
+        m_media.reset();
         if (m_event_handler)
         {
             m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::CALL_CANCELLED, ' ', 0, SipClientEvent::CancelReason::TARGET_BUSY });
@@ -266,12 +385,24 @@ public:
 
     void call_declined(const ev_603_decline& /*unused*/)
     {
+        end_dialog(own_dialog_key());
+        m_media.reset();
         if (m_event_handler)
         {
             m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::CALL_CANCELLED, ' ', 0, SipClientEvent::CancelReason::CALL_DECLINED });
         }
     }
 
+    void call_declined(const ev_invite_failed& /*unused*/)
+    {
+        end_dialog(own_dialog_key());
+        m_media.reset();
+        if (m_event_handler)
+        {
+            m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::CALL_CANCELLED, ' ', 0, SipClientEvent::CancelReason::CALL_FAILED });
+        }
+    }
+
     void handle_bye()
     {
         m_sip_sequence_number++;
@@ -281,6 +412,25 @@ public:
         }
     }
 
+    void handle_media_timeout()
+    {
+        ESP_LOGW(TAG, "No rtp received for %d s, ending the call", static_cast<int>(MEDIA_TIMEOUT.count()));
+        if (m_event_handler)
+        {
+            m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::CALL_END });
+        }
+    }
+
+    /**
+     * Called whenever the established call is left, for any reason
+     */
+    void leave_call()
+    {
+        m_dialogs.clear();
+        log_rtp_statistics();
+        m_media.reset();
+    }
+
     void handle_internal_server_error()
     {
         m_tag = std::rand() % 2147483647;
@@ -288,156 +438,572 @@ public:
         m_sip_sequence_number++;
 
         // wait for timeout and restart again
-        m_timer.expires_after(asio::chrono::seconds(5));
-
-        m_timer.async_wait([this](const asio::error_code& ec) {
-            if (!ec)
-            {
-                this->m_sm.process_event(ev_start {});
-            }
+        m_timer_wheel->start(m_timer, asio::chrono::seconds(5), [this]() {
+            this->m_sm.process_event(ev_start {});
         });
     }
 
 private:
-    void rx(std::string recv_string)
+    friend class RxDispatchTable<SipClientInt>;
+
+    /**
+     * Client transaction of a sent request, pending until its final response
+     */
+    struct Transaction
+    {
+        std::string_view method;
+        /** Copy of the sent request for the retransmissions, only holds memory while the transaction is pending */
+        std::string message;
+        asio::chrono::milliseconds interval {};
+        /** Timer A / E */
+        TimerWheel::Timer retransmit_timer;
+        /** Timer B / F */
+        TimerWheel::Timer timeout_timer;
+    };
+
+    /**
+     * Last digest challenge (401 or 407) for a kind of request
+     *
+     * With qop=auth the nonce is used again for the following requests with an incremented
+     * nonce count, until the server rejects it.
+     */
+    struct DigestChallenge
+    {
+        std::string realm;
+        std::string nonce;
+        std::string cnonce;
+        /** Last computed response, only sent if authorized is set */
+        HexDigest response;
+        uint32_t nonce_count { 0 };
+        DigestAlgorithm algorithm { DigestAlgorithm::MD5 };
+        bool authorized { false };
+        bool qop_auth { false };
+        bool proxy { false };
+    };
+
+    /**
+     * Dialog of a call, in-dialog requests (BYE, INFO) are only accepted for known dialogs
+     */
+    struct Dialog
+    {
+        bool outgoing { false };
+    };
+
+    static constexpr size_t SDP_ANSWER_SIZE = 640;
+
+    /**
+     * Media state of the current call, only allocated from the start to the end of a call
+     *
+     * Most of it is the jitter buffer, so an idle account (or one on a socket, that cannot carry rtp) stays small.
+     */
+    struct CallMedia
+    {
+        CallMedia(asio::io_context& io_context, RtpSocketT& rtp_socket, const Announcement* announcement)
+            : announcement_player(io_context, rtp_socket)
+        {
+            announcement_player.set_announcement(announcement);
+        }
+
+        AnnouncementPlayer<RtpSocketT> announcement_player;
+        RtpReceiver<> rtp_receiver;
+        DtmfDetector dtmf_detector;
+        /** Negotiated audio stream, nothing is sent or received without one */
+        SdpAudioStream audio_stream;
+        /** Sdp of the 200 OK to the INVITE, for its retransmissions */
+        Buffer<SDP_ANSWER_SIZE> sdp_answer;
+        TimerWheel::Timer media_timer;
+        /** Set for each received RTP datagram, checked by the media timer */
+        bool rtp_received { false };
+        TimerWheel::Timer playout_timer;
+        TimerWheel::ClockT::time_point playout_deadline;
+    };
+
+    void rx(std::string_view recv_data)
     {
-        if (recv_string.empty())
+        if (recv_data.empty())
         {
             return;
         }
 
-        SipPacket packet(const_cast<char*>(recv_string.data()), recv_string.size());
+        SipPacket packet(recv_data.data(), recv_data.size());
         if (!packet.parse())
         {
             ESP_LOGI(TAG, "Parsing the packet failed");
             return;
         }
 
-        m_command_timeout_timer.cancel();
+        if (packet.is_response())
+        {
+            if (!rx_response(packet))
+            {
+                return;
+            }
+        }
+        else
+        {
+            ESP_LOGI(TAG, "Parsing the packet ok, method=%d", static_cast<int>(packet.get_method()));
+        }
+        RxDispatchTable<SipClientInt>::dispatch(*this, packet);
+    }
+
+    /**
+     * Handles a datagram received on the rtp socket, the audio goes into the jitter buffer of its SSRC
+     */
+    void rx_rtp(std::string_view data)
+    {
+        const auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch());
+        // arrival time in units of the 8 kHz rtp clock of the offered codecs
+        const auto arrival = static_cast<uint32_t>(now.count() / 125);
+        if (m_media == nullptr)
+        {
+            ESP_LOGV(TAG, "Dropping rtp packet outside of a call");
+            return;
+        }
+        m_media->rtp_received = true;
+        if (!m_media->rtp_receiver.rx(data, arrival))
+        {
+            ESP_LOGV(TAG, "Dropping rtp packet of %d byte", static_cast<int>(data.size()));
+        }
+    }
+
+    /**
+     * Matches a response to one of the sent requests, before its event is dispatched
+     *
+     * Responses, that do not belong to a pending transaction (e.g. late responses of an old call)
+     * are dropped. Only responses to the INVITE update the dialog state.
+     *
+     * \return false if the response is dropped
+     */
+    bool rx_response(const SipPacket& packet)
+    {
+        const uint64_t key = sip_key(packet.get_call_id(), packet.get_from_tag(), packet.get_via_branch(), packet.get_cseq_method());
+        Transaction* transaction = m_transactions.find(key);
+        if (transaction == nullptr)
+        {
+            if (is_invite_ok_retransmission(packet))
+            {
+                // the callee sends the 200 OK again until it receives the ACK
+                ESP_LOGI(TAG, "Acking retransmitted 200 OK");
+                send_sip_ack();
+                return false;
+            }
+            ESP_LOGI(TAG, "Dropping response %d without matching transaction", static_cast<int>(packet.get_status_code()));
+            return false;
+        }
+        const bool is_invite = (transaction->method == INVITE);
+
+        if (packet.get_status_code() >= 200)
+        {
+            erase_transaction(key, *transaction);
+        }
+        else if (is_invite)
+        {
+            // proceeding: the server got the INVITE, wait for the final response without timeout
+            transaction->retransmit_timer.cancel();
+            transaction->timeout_timer.cancel();
+        }
+        else
+        {
+            transaction->interval = T2;
+        }
 
-        const SipPacket::Status reply = packet.get_status();
         ESP_LOGI(TAG, "Parsing the packet ok, reply code=%d", static_cast<int>(packet.get_status()));
 
-        if (reply == SipPacket::Status::SERVER_ERROR_500)
+        if (is_invite)
         {
-            m_sm.process_event(ev_500_internal_server_error {});
-            return;
+            if (!packet.get_contact().empty())
+            {
+                m_to_contact = packet.get_contact();
+            }
+
+            if (!packet.get_to_tag().empty())
+            {
+                m_to_tag = packet.get_to_tag();
+            }
+
+            /* TODO: only copy record route, when not empty */
+            std::copy(packet.get_record_route().begin(), packet.get_record_route().end(), m_record_route.begin());
         }
-        if ((reply == SipPacket::Status::UNAUTHORIZED_401) || (reply == SipPacket::Status::PROXY_AUTH_REQ_407))
+        if (is_invite && (packet.get_status() == SipPacket::Status::OK_200))
+        {
+            apply_sdp_answer(packet);
+        }
+        return true;
+    }
+
+    /**
+     * True for a 200 OK to the INVITE of the current outgoing call, after its transaction ended with the first one
+     */
+    bool is_invite_ok_retransmission(const SipPacket& packet)
+    {
+        if ((packet.get_status() != SipPacket::Status::OK_200) || (packet.get_cseq_method() != INVITE))
         {
-            m_realm = packet.get_realm();
-            m_nonce = packet.get_nonce();
-            m_proxy_auth = (reply == SipPacket::Status::PROXY_AUTH_REQ_407);
+            return false;
         }
-        else if ((reply == SipPacket::Status::UNKNOWN) && ((packet.get_method() == SipPacket::Method::NOTIFY) || (packet.get_method() == SipPacket::Method::BYE) || (packet.get_method() == SipPacket::Method::INFO)))
+        const Dialog* dialog = m_dialogs.find(sip_key(packet.get_call_id()));
+        if ((dialog == nullptr) || !dialog->outgoing)
         {
-            send_sip_ok(packet);
+            return false;
         }
+        const std::string_view cseq = packet.get_cseq();
+        uint32_t sequence_number = 0;
+        std::from_chars(cseq.data(), cseq.data() + cseq.size(), sequence_number);
+        return sequence_number == m_sip_sequence_number;
+    }
 
-        if (!packet.get_contact().empty())
+    /**
+     * Allocates the media state for a new call, a previous one is dropped
+     */
+    void start_call_media()
+    {
+        m_media = std::make_unique<CallMedia>(m_io_context, m_rtp_socket, m_announcement);
+        m_media->rtp_receiver.set_telephone_event_callback([this](const RtpPacket& packet, const TelephoneEvent& event) {
+            ESP_LOGD(TAG, "Telephone event %u (%c) end=%d duration=%u timestamp=%u", event.event, event.dtmf_signal(), event.end, event.duration, static_cast<unsigned>(packet.get_timestamp()));
+            if (m_media->dtmf_detector.detect(packet, event) && m_event_handler)
+            {
+                const auto duration = static_cast<uint16_t>(event.duration / DtmfDetector::CLOCK_RATE_KHZ);
+                m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::BUTTON_PRESS, event.dtmf_signal(), duration });
+            }
+        });
+    }
+
+    /**
+     * Ends the call with ev_media_timeout, if no RTP is received within MEDIA_TIMEOUT
+     *
+     * Only armed, if the peer sends audio. Otherwise a lost BYE would keep the call forever.
+     */
+    void start_media_timer()
+    {
+        if (!m_media->audio_stream.can_receive())
         {
-            m_to_contact = packet.get_contact();
+            return;
         }
+        m_media->rtp_received = false;
+        m_timer_wheel->start(m_media->media_timer, MEDIA_TIMEOUT, [this]() {
+            if (m_media->rtp_received)
+            {
+                start_media_timer();
+                return;
+            }
+            m_sm.process_event(ev_media_timeout {});
+        });
+    }
 
-        if (!packet.get_to_tag().empty())
+    /**
+     * Plays out the jitter buffer every FRAME_DURATION, if the peer sends audio
+     *
+     * The play out is paced by deadlines, so that the 10 ms resolution of the timer wheel does not add up.
+     */
+    void start_playout()
+    {
+        if (!m_media->audio_stream.can_receive())
         {
-            m_to_tag = packet.get_to_tag();
+            return;
         }
+        m_media->playout_deadline = TimerWheel::ClockT::now();
+        play_out();
+    }
 
-        /* TODO: only copy record route, when not empty */
-        m_record_route = packet.get_record_route();
+    void play_out()
+    {
+        const auto now = TimerWheel::ClockT::now();
+        CallMedia& media = *m_media;
+        if (now - media.playout_deadline > MAX_PLAYOUT_LAG)
+        {
+            // after a stall the missed frames are skipped by the jitter buffer, instead of played as burst
+            media.playout_deadline = now;
+        }
+        while (media.playout_deadline <= now)
+        {
+            const auto* frame = media.rtp_receiver.pop();
+            if (m_audio_handler)
+            {
+                m_audio_handler(m_sip_client, (frame == nullptr) ? std::string_view() : frame->payload(), (frame == nullptr) ? 0 : frame->payload_type);
+            }
+            media.playout_deadline += FRAME_DURATION;
+        }
+        m_timer_wheel->start(media.playout_timer, media.playout_deadline - now, [this]() {
+            play_out();
+        });
+    }
 
-        if ((reply == SipPacket::Status::UNAUTHORIZED_401) || (reply == SipPacket::Status::PROXY_AUTH_REQ_407))
+    void log_rtp_statistics()
+    {
+        if (m_media == nullptr)
         {
-            m_sm.process_event(ev_401_unauthorized {});
+            return;
         }
-        else if (reply == SipPacket::Status::OK_200)
+        const auto* buffer = m_media->rtp_receiver.current();
+        if (buffer == nullptr)
         {
-            m_sm.process_event(ev_200_ok { packet.get_contact_expires() });
+            return;
         }
-        else if (reply == SipPacket::Status::TRYING_100)
+        const auto& statistics = buffer->get_statistics();
+        ESP_LOGI(TAG, "Rtp received: %u, lost: %u, late: %u, duplicates: %u, too large: %u, invalid: %u, jitter: %u ms",
+            static_cast<unsigned>(statistics.received), static_cast<unsigned>(statistics.lost), static_cast<unsigned>(statistics.late),
+            static_cast<unsigned>(statistics.duplicates), static_cast<unsigned>(statistics.too_large), static_cast<unsigned>(m_media->rtp_receiver.get_invalid()),
+            static_cast<unsigned>(statistics.jitter / DtmfDetector::CLOCK_RATE_KHZ));
+    }
+
+    /**
+     * Takes the audio stream from the SDP answer in the 200 OK to the own INVITE
+     *
+     * The call is established in any case, without a usable answer no audio is sent.
+     */
+    void apply_sdp_answer(const SipPacket& packet)
+    {
+        if (m_media == nullptr)
         {
-            m_sm.process_event(ev_100_trying {});
+            return;
         }
-        else if (reply == SipPacket::Status::SESSION_PROGRESS_183)
+        SdpSession answer;
+        if ((packet.get_content_type() != SipPacket::ContentType::APPLICATION_SDP) || !answer.parse(packet.get_body()) || !SdpAudioStream::negotiate(answer, has_announcement(), m_media->audio_stream))
         {
-            m_sm.process_event(ev_183_session_progress {});
+            ESP_LOGW(TAG, "No usable sdp answer, not sending audio");
+            m_media->audio_stream = {};
+            return;
         }
-        else if (reply == SipPacket::Status::REQUEST_CANCELLED_487)
+        apply_audio_stream(answer);
+    }
+
+    /**
+     * Sends the RTP to the negotiated address and receives the telephone events with the negotiated payload type
+     *
+     * If the address cannot be used, the audio stream is dropped, so that no audio is sent to the previous destination.
+     */
+    void apply_audio_stream(const SdpSession& session)
+    {
+        SdpAudioStream& audio_stream = m_media->audio_stream;
+        const SdpMedia& media = session.media(audio_stream.media_index);
+        if (!m_rtp_socket.set_destination(session.connection_address(media), audio_stream.port))
+        {
+            ESP_LOGW(TAG, "Cannot send rtp to the negotiated address, not using audio");
+            audio_stream = {};
+            return;
+        }
+        const uint8_t telephone_event = audio_stream.payload_type(RtpReceiver<>::DEFAULT_TELEPHONE_EVENT_PAYLOAD_TYPE);
+        m_media->rtp_receiver.set_telephone_event_payload_type((telephone_event == SdpAudioStream::NONE) ? RtpReceiver<>::DEFAULT_TELEPHONE_EVENT_PAYLOAD_TYPE : telephone_event);
+    }
+
+    /**
+     * Plays the announcement, if its codec was negotiated and the peer receives audio
+     */
+    void start_announcement()
+    {
+        if (!has_announcement())
         {
-            m_sm.process_event(ev_487_request_cancelled {});
+            return;
         }
-        else if (reply == SipPacket::Status::DECLINE_603)
+        const uint8_t own_payload_type = m_announcement->get_payload_type();
+        if (!m_media->audio_stream.can_send(own_payload_type))
         {
-            send_sip_ack();
-            m_sip_sequence_number++;
-            m_branch = std::rand() % 2147483647;
+            ESP_LOGI(TAG, "Peer does not receive the codec of the announcement, not playing it");
+            return;
+        }
+        m_media->announcement_player.start(m_media->audio_stream.payload_type(own_payload_type));
+    }
 
-            m_sm.process_event(ev_603_decline {});
+    /**
+     * Handlers of the events of received packets (see RxEvents), by default the event is passed to the state machine
+     */
+    template <typename EventT>
+    void on_rx_event(const SipPacket& /*packet*/, const EventT& event)
+    {
+        m_sm.process_event(event);
+    }
+
+    void on_rx_event(const SipPacket& packet, const ev_401_unauthorized& event)
+    {
+        const bool proxy = (packet.get_status() == SipPacket::Status::PROXY_AUTH_REQ_407);
+        set_challenge((packet.get_cseq_method() == REGISTER) ? m_register_auth : m_invite_auth, packet, proxy);
+        m_sm.process_event(event);
+    }
+
+    void on_rx_event(const SipPacket& /*packet*/, const ev_486_busy_here& event)
+    {
+        ack_declined_invite();
+        m_sm.process_event(event);
+    }
+
+    void on_rx_event(const SipPacket& /*packet*/, const ev_603_decline& event)
+    {
+        ack_declined_invite();
+        m_sm.process_event(event);
+    }
+
+    /**
+     * Any other final error response to the INVITE ends the call like a 603, other responses without an event are ignored
+     */
+    void on_rx_event(const SipPacket& packet, const ev_invite_failed& event)
+    {
+        if ((packet.get_status_code() < 300) || (packet.get_cseq_method() != INVITE))
+        {
+            return;
         }
-        else if (reply == SipPacket::Status::BUSY_HERE_486)
+        ack_declined_invite();
+        m_sm.process_event(event);
+    }
+
+    /**
+     * A 500 to the INVITE fails the call, the registration is restarted only for a 500 to the REGISTER
+     */
+    void on_rx_event(const SipPacket& packet, const ev_500_internal_server_error& event)
+    {
+        if (packet.get_cseq_method() == INVITE)
         {
-            send_sip_ack();
-            m_sip_sequence_number++;
-            m_branch = std::rand() % 2147483647;
+            on_rx_event(packet, ev_invite_failed {});
+            return;
+        }
+        m_sm.process_event(event);
+    }
 
-            m_sm.process_event(ev_486_busy_here {});
+    void on_rx_event(const SipPacket& packet, const ev_rx_notify& /*unused*/)
+    {
+        send_sip_ok(packet);
+    }
+
+    /**
+     * BYE and INFO are only accepted inside of a known dialog
+     */
+    void on_rx_event(const SipPacket& packet, const ev_rx_bye& event)
+    {
+        const uint64_t dialog_key = sip_key(packet.get_call_id());
+        if (!accept_in_dialog(packet, dialog_key))
+        {
+            return;
         }
+        end_dialog(dialog_key);
+        m_sm.process_event(event);
+    }
 
-        if (packet.get_method() == SipPacket::Method::BYE)
+    void on_rx_event(const SipPacket& packet, const ev_rx_info& /*unused*/)
+    {
+        if (!accept_in_dialog(packet, sip_key(packet.get_call_id())))
         {
-            m_sm.process_event(ev_rx_bye {});
+            return;
         }
-        else if ((packet.get_method() == SipPacket::Method::INFO)
-            && (packet.get_content_type() == SipPacket::ContentType::APPLICATION_DTMF_RELAY))
+        if ((packet.get_content_type() == SipPacket::ContentType::APPLICATION_DTMF_RELAY) && m_event_handler)
         {
-            if (m_event_handler)
-            {
-                m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::BUTTON_PRESS, packet.get_dtmf_signal(), packet.get_dtmf_duration() });
-            }
+            m_event_handler(m_sip_client, SipClientEvent { SipClientEvent::Event::BUTTON_PRESS, packet.get_dtmf_signal(), packet.get_dtmf_duration() });
         }
+    }
 
+    void on_rx_event(const SipPacket& packet, const ev_rx_invite& /*unused*/)
+    {
         // Do not accept calls to e.g. **9 on fritzbox from self.
         // But immediately pick up all other calls, also to **9 from other participants.
-        if ((packet.get_method() == SipPacket::Method::INVITE) && (packet.get_from().rfind(m_caller_display + "\"", 1) != 1))
+        if (packet.get_from().rfind(m_caller_display + "\"", 1) == 1)
         {
-            ESP_LOGV(TAG, "Accept invite from : '%s'", packet.get_from().c_str());
-            send_sip_ok(packet);
-            m_sm.process_event(ev_rx_invite {});
+            ESP_LOGV(TAG, "Drop invite from : %.*s", static_cast<int>(packet.get_from().size()), packet.get_from().data());
+            send_sip_decline(packet);
+            return;
         }
-        else if (packet.get_method() == SipPacket::Method::INVITE)
+        ESP_LOGV(TAG, "Accept invite from : '%.*s'", static_cast<int>(packet.get_from().size()), packet.get_from().data());
+        const Dialog* dialog = m_dialogs.find(sip_key(packet.get_call_id()));
+        if ((dialog != nullptr) && !dialog->outgoing)
         {
-            ESP_LOGV(TAG, "Drop invite from : %s", packet.get_from().c_str());
-            send_sip_decline(packet);
+            // retransmission, the 200 OK was lost
+            send_sip_invite_ok(packet);
+            return;
+        }
+
+        // the offer is only parsed here, its views point into the received packet.
+        // Stream and answer are only taken over by handle_invite(), a rejected INVITE does not change the ongoing call.
+        SdpSession offer;
+        SdpAudioStream audio_stream;
+        const bool has_offer = (packet.get_content_type() == SipPacket::ContentType::APPLICATION_SDP) && !packet.get_body().empty();
+        if (has_offer && (!offer.parse(packet.get_body()) || !SdpAudioStream::negotiate(offer, has_announcement(), audio_stream)))
+        {
+            ESP_LOGI(TAG, "No common codec offered, rejecting invite");
+            send_sip_reply("488 Not Acceptable Here", packet);
+            return;
+        }
+        Buffer<SDP_ANSWER_SIZE> answer;
+        if (!render_sdp(has_offer ? &offer : nullptr, audio_stream, answer))
+        {
+            send_sip_reply("500 Server Internal Error", packet);
+            return;
+        }
+        if (!m_sm.process_event(ev_rx_invite { &packet, has_offer ? &offer : nullptr, &audio_stream, std::string_view(answer.data(), answer.size()) }))
+        {
+            ESP_LOGI(TAG, "Not taking a call now, rejecting invite");
+            send_sip_reply("486 Busy Here", packet);
         }
     }
 
+    /**
+     * Renders the sdp of the 200 OK to an INVITE: the answer to the offer with the negotiated
+     * audio stream, or the own offer if the INVITE has none (RFC 3261 13.2.1)
+     *
+     * \return false if it does not fit
+     */
+    template <typename BufferT>
+    bool render_sdp(const SdpSession* offer, const SdpAudioStream& audio_stream, BufferT& out) const
+    {
+        const auto session_id = static_cast<uint32_t>(std::rand());
+        out << m_templates.sdp_origin_prefix() << session_id << " " << session_id;
+        if (offer == nullptr)
+        {
+            out << m_templates.sdp_origin_suffix();
+        }
+        else
+        {
+            out << m_templates.sdp_session_suffix();
+            audio_stream.write_answer(*offer, m_local_rtp_port, out);
+        }
+        if (out.is_truncated())
+        {
+            ESP_LOGW(TAG, "Sdp answer does not fit into %d byte", static_cast<int>(SDP_ANSWER_SIZE));
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Answers an in-dialog request with 200 OK or with 481, if the dialog is unknown
+     *
+     * \return true if the dialog is known
+     */
+    bool accept_in_dialog(const SipPacket& packet, uint64_t dialog_key)
+    {
+        if (m_dialogs.find(dialog_key) == nullptr)
+        {
+            ESP_LOGI(TAG, "Rejecting request outside of a dialog");
+            send_sip_reply("481 Call/Transaction Does Not Exist", packet);
+            return false;
+        }
+        send_sip_ok(packet);
+        return true;
+    }
+
+    /**
+     * Acks a final error response to the INVITE (e.g. 486 or 603), the next request starts a new transaction
+     */
+    void ack_declined_invite()
+    {
+        send_sip_ack();
+        m_sip_sequence_number++;
+        m_branch = std::rand() % 2147483647;
+    }
+
     void send_sip_register()
     {
         TxBufferT& tx_buffer = m_socket.get_new_tx_buf();
-        const std::string uri = "sip:" + m_server_ip;
 
-        send_sip_header("REGISTER", uri, "sip:" + m_user + "@" + m_server_ip, tx_buffer);
+        send_sip_header("REGISTER", m_templates.register_uri(), m_templates.user_uri(), tx_buffer);
 
-        tx_buffer << "Contact: \"" << m_user << "\" <sip:" << m_user << "@" << m_my_ip << ":" << LOCAL_PORT << ";transport=" << TRANSPORT_LOWER << ">\r\n";
+        tx_buffer << m_templates.contact_line();
 
-        if (!m_response.empty())
+        if (m_register_auth.authorized)
         {
-            tx_buffer << "Authorization: Digest username=\"" << m_user << "\", realm=\"" << m_realm << "\", nonce=\"" << m_nonce << "\", uri=\"" << uri << "\", algorithm=MD5, response=\"" << m_response << "\"\r\n";
+            add_authorization(tx_buffer, AUTHORIZATION, m_register_auth, m_templates.register_uri(), true);
         }
-        tx_buffer << "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\n";
+        tx_buffer << SipMessageTemplates::ALLOW_LINE;
         tx_buffer << "Expires: 3600\r\n";
         tx_buffer << "Content-Length: 0\r\n";
         tx_buffer << "\r\n";
 
-        m_socket.send_buffered_data();
-        m_command_timeout_timer.expires_after(asio::chrono::seconds(5));
-        m_command_timeout_timer.async_wait([this](const asio::error_code& ec) {
-            if (!ec)
-            {
-                this->m_sm.process_event(ev_reply_timeout {});
-            }
-        });
+        send_request(REGISTER, tx_buffer);
     }
 
     void send_sip_invite()
@@ -446,36 +1012,26 @@ private:
 
         send_sip_header("INVITE", m_uri, m_to_uri, tx_buffer);
 
-        tx_buffer << "Contact: \"" << m_user << "\" <sip:" << m_user << "@" << m_my_ip << ":" << LOCAL_PORT << ";transport=" << TRANSPORT_LOWER << ">\r\n";
+        tx_buffer << m_templates.contact_line();
 
-        if (!m_response.empty())
+        if (m_invite_auth.authorized)
         {
-            if (m_proxy_auth)
-            {
-                tx_buffer << "Proxy-";
-            }
-            tx_buffer << "Authorization: Digest username=\"" << m_user << "\", realm=\"" << m_realm << "\", nonce=\"" << m_nonce << "\", uri=\"" << m_uri << "\", response=\"" << m_response << "\"\r\n";
+            add_authorization(tx_buffer, m_invite_auth.proxy ? PROXY_AUTHORIZATION : AUTHORIZATION, m_invite_auth, m_uri, false);
         }
         tx_buffer << "Content-Type: application/sdp\r\n";
-        tx_buffer << "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\n";
-        m_tx_sdp_buffer.clear();
-        m_tx_sdp_buffer << "v=0\r\n"
-                        << "o=" << m_user << " " << m_sdp_session_id << " " << m_sdp_session_id << " IN IP4 " << m_my_ip << "\r\n"
-                        << "s=sip-client/0.0.1\r\n"
-                        << "c=IN IP4 " << m_my_ip << "\r\n"
-                        << "t=0 0\r\n"
-                        << "m=audio " << LOCAL_RTP_PORT << " RTP/AVP 0 8 101\r\n"
-                        // << "a=sendrecv\r\n"
-                        << "a=recvonly\r\n"
-                        << "a=rtpmap:101 telephone-event/8000\r\n"
-                        << "a=fmtp:101 0-15\r\n"
-                        << "a=ptime:20\r\n";
-
-        tx_buffer << "Content-Length: " << m_tx_sdp_buffer.size() << "\r\n";
+        tx_buffer << SipMessageTemplates::ALLOW_LINE;
+        m_sdp_session_ids.clear();
+        m_sdp_session_ids << m_sdp_session_id << " " << m_sdp_session_id;
+
+        const std::string& sdp_prefix = m_templates.sdp_origin_prefix();
+        const std::string& sdp_suffix = m_templates.sdp_origin_suffix();
+        tx_buffer << "Content-Length: " << (sdp_prefix.size() + m_sdp_session_ids.size() + sdp_suffix.size()) << "\r\n";
         tx_buffer << "\r\n";
-        tx_buffer << m_tx_sdp_buffer.data();
 
-        m_socket.send_buffered_data();
+        m_dialogs.insert(own_dialog_key(), Dialog { true });
+
+        // the sdp body is sent directly from the templates, without copying it into the tx buffer
+        send_request(INVITE, tx_buffer, asio::buffer(sdp_prefix), asio::buffer(m_sdp_session_ids.data(), m_sdp_session_ids.size()), asio::buffer(sdp_suffix));
     }
 
     /**
@@ -491,16 +1047,16 @@ private:
 
         send_sip_header("CANCEL", m_uri, m_to_uri, tx_buffer);
 
-        if (!m_response.empty())
+        if (m_invite_auth.authorized)
         {
-            tx_buffer << "Contact: \"" << m_user << "\" <sip:" << m_user << "@" << m_my_ip << ":" << LOCAL_PORT << ";transport=" << TRANSPORT_LOWER << ">\r\n";
+            tx_buffer << m_templates.contact_line();
             tx_buffer << "Content-Type: application/sdp\r\n";
-            tx_buffer << "Authorization: Digest username=\"" << m_user << "\", realm=\"" << m_realm << "\", nonce=\"" << m_nonce << "\", uri=\"" << m_uri << "\", response=\"" << m_response << "\"\r\n";
+            add_authorization(tx_buffer, AUTHORIZATION, m_invite_auth, m_uri, false);
         }
         tx_buffer << "Content-Length: 0\r\n";
         tx_buffer << "\r\n";
 
-        m_socket.send_buffered_data();
+        send_request(CANCEL, tx_buffer);
     }
 
     void send_sip_ack()
@@ -514,72 +1070,86 @@ private:
         {
             send_sip_header("ACK", m_uri, m_to_uri, tx_buffer);
         }
-        // std::string m_sdp_session_o;
-        // std::string m_sdp_session_s;
-        // std::string m_sdp_session_c;
-        // m_tx_sdp_buffer.clear();
-        // TODO: populate sdp body
-        // m_tx_sdp_buffer << "v=0\r\n"
-        //	              << m_sdp_session_o << "\r\n"
-        //	      << m_sdp_session_s << "\r\n"
-        //	      << m_sdp_session_c << "\r\n"
-        //	      << "t=0 0\r\n";
-        // TODO: copy each m line and select appropriate a line
-        // tx_buffer << "Content-Type: application/sdp\r\n";
-        // tx_buffer << "Content-Length: " << m_tx_sdp_buffer.size() << "\r\n";
-        // tx_buffer << "Allow-Events: telephone-event\r\n";
+        // the offer was sent with the INVITE and the answer received with the 200 OK, so the ACK has no body
         tx_buffer << "Content-Length: 0\r\n";
         tx_buffer << "\r\n";
-        // tx_buffer << m_tx_sdp_buffer.data();
 
         m_socket.send_buffered_data();
     }
 
     void send_sip_ok(const SipPacket& packet)
     {
+        send_sip_reply("200 OK", packet);
+    }
+
+    /**
+     * 200 OK to an INVITE with the Contact of the dialog and the sdp answer of the call
+     */
+    void send_sip_invite_ok(const SipPacket& packet)
+    {
+        const std::string_view sdp_answer(m_media->sdp_answer.data(), m_media->sdp_answer.size());
         TxBufferT& tx_buffer = m_socket.get_new_tx_buf();
 
         send_sip_reply_header("200 OK", packet, tx_buffer);
-        tx_buffer << "Content-Length: 0\r\n";
+        tx_buffer << m_templates.contact_line();
+        tx_buffer << "Content-Type: application/sdp\r\n";
+        tx_buffer << "Content-Length: " << sdp_answer.size() << "\r\n";
         tx_buffer << "\r\n";
+        // copied, the media state of the call may be gone before the datagram is sent (e.g. BYE in the same receive batch)
+        tx_buffer << sdp_answer;
 
         m_socket.send_buffered_data();
     }
 
     void send_sip_decline(const SipPacket& packet)
+    {
+        send_sip_reply("603 Decline", packet);
+    }
+
+    void send_sip_reply(std::string_view code, const SipPacket& packet)
     {
         TxBufferT& tx_buffer = m_socket.get_new_tx_buf();
 
-        send_sip_reply_header("603 Decline", packet, tx_buffer);
+        send_sip_reply_header(code, packet, tx_buffer);
         tx_buffer << "Content-Length: 0\r\n";
         tx_buffer << "\r\n";
 
         m_socket.send_buffered_data();
     }
 
-    void send_sip_header(const std::string& command, const std::string& uri, const std::string& to_uri, TxBufferT& stream)
+    void send_sip_header(std::string_view command, std::string_view uri, std::string_view to_uri, TxBufferT& stream)
     {
-        stream << command << " " << uri << " SIP/2.0\r\n";
+        if (command == "REGISTER")
+        {
+            stream << m_templates.register_request_line();
+        }
+        else
+        {
+            stream << command << " " << uri << " SIP/2.0\r\n";
+        }
 
         stream << "CSeq: " << m_sip_sequence_number << " " << command << "\r\n";
-        stream << "Call-ID: " << m_call_id << "@" << m_my_ip << "\r\n";
-        stream << "Max-Forwards: 70\r\n";
-        stream << "User-Agent: sip-client/0.0.1\r\n";
+        stream << "Call-ID: " << m_call_id << m_templates.call_id_suffix();
+        stream << SipMessageTemplates::MAX_FORWARDS_AND_USER_AGENT_LINES;
         if (command == "REGISTER")
         {
-            stream << "From: <sip:" << m_user << "@" << m_server_ip << ">;tag=" << m_tag << "\r\n";
+            stream << m_templates.register_from_prefix() << m_tag << "\r\n";
         }
         else if (command == "INVITE")
         {
-            stream << "From: \"" << m_caller_display << "\" <sip:" << m_user << "@" << m_server_ip << ">;tag=" << m_tag << "\r\n";
+            stream << "From: \"" << m_caller_display << m_templates.from_display_suffix() << m_tag << "\r\n";
         }
         else
         {
-            stream << "From: \"" << m_user << "\" <sip:" << m_user << "@" << m_server_ip << ">;tag=" << m_tag << "\r\n";
+            stream << m_templates.from_prefix() << m_tag << "\r\n";
         }
-        stream << "Via: SIP/2.0/" << TRANSPORT_UPPER << " " << m_my_ip << ":" << LOCAL_PORT << ";branch=z9hG4bK-" << m_branch << ";rport\r\n";
+        stream << m_templates.via_prefix() << m_branch << ";rport\r\n";
 
-        if ((command == "ACK") && !m_to_tag.empty())
+        if (command == "REGISTER")
+        {
+            stream << m_templates.register_to_line();
+        }
+        else if ((command == "ACK") && !m_to_tag.empty())
         {
             stream << "To: <" << to_uri << ">;tag=" << m_to_tag << "\r\n";
         }
@@ -600,7 +1170,7 @@ private:
         }
     }
 
-    void send_sip_reply_header(const std::string& code, const SipPacket& packet, TxBufferT& stream)
+    void send_sip_reply_header(std::string_view code, const SipPacket& packet, TxBufferT& stream)
     {
         stream << "SIP/2.0 " << code << "\r\n";
 
@@ -630,6 +1200,142 @@ private:
         stream << "Max-Forwards: 70\r\n";
     }
 
+    /**
+     * Call-ID of the sent requests, e.g. 1234@192.168.170.30
+     */
+    Buffer<64> own_call_id() const
+    {
+        Buffer<64> call_id;
+        call_id << m_call_id << "@" << m_my_ip;
+        return call_id;
+    }
+
+    uint64_t own_dialog_key() const
+    {
+        const Buffer<64> call_id = own_call_id();
+        return sip_key(std::string_view(call_id.data(), call_id.size()));
+    }
+
+    /**
+     * Sends a request and starts its client transaction
+     *
+     * The transaction keeps a copy of the request, which is retransmitted until a response
+     * is received (RFC 3261 timer A for INVITE, timer E otherwise). Without a final response,
+     * the transaction times out after 64*T1 (timer B / F) with ev_reply_timeout.
+     */
+    template <typename... Fragments>
+    void send_request(std::string_view method, const TxBufferT& tx_buffer, const Fragments&... body)
+    {
+        const uint64_t key = transaction_key(method);
+        Transaction* transaction = m_transactions.insert(key);
+        if (transaction == nullptr)
+        {
+            // cannot happen with the timeouts of all transactions, but be safe
+            ESP_LOGW(TAG, "Too many pending transactions, dropping all of them");
+            clear_transactions();
+            transaction = m_transactions.insert(key);
+        }
+        transaction->method = method;
+        if (transaction->message.capacity() == 0)
+        {
+            transaction->message.swap(m_spare_message);
+        }
+        transaction->message.assign(tx_buffer.data(), tx_buffer.size());
+        (transaction->message.append(static_cast<const char*>(asio::const_buffer(body).data()), asio::const_buffer(body).size()), ...);
+
+        transaction->interval = T1;
+        m_timer_wheel->start(transaction->retransmit_timer, T1, [this, key]() {
+            retransmit(key);
+        });
+        m_timer_wheel->start(transaction->timeout_timer, TRANSACTION_TIMEOUT, [this, key]() {
+            transaction_timed_out(key);
+        });
+
+        m_socket.send_buffered_data(body...);
+    }
+
+    /**
+     * Returns the key of the client transaction for the request, that is about to be sent
+     *
+     * The key is built from the same values as sent in the Call-ID, From tag, Via branch and CSeq,
+     * so that rx_response() finds it with the values of the response.
+     */
+    uint64_t transaction_key(std::string_view method)
+    {
+        const Buffer<64> call_id = own_call_id();
+        Buffer<16> tag;
+        tag << m_tag;
+        Buffer<32> branch;
+        branch << SipMessageTemplates::BRANCH_PREFIX << m_branch;
+        return sip_key(std::string_view(call_id.data(), call_id.size()), std::string_view(tag.data(), tag.size()), std::string_view(branch.data(), branch.size()), method);
+    }
+
+    void erase_transaction(uint64_t key, Transaction& transaction)
+    {
+        transaction.retransmit_timer.cancel();
+        transaction.timeout_timer.cancel();
+        // keep one buffer for the next request, otherwise each slot would keep the capacity of the largest request it ever held
+        if (transaction.message.capacity() > m_spare_message.capacity())
+        {
+            transaction.message.swap(m_spare_message);
+        }
+        std::string().swap(transaction.message);
+        m_transactions.erase(key);
+    }
+
+    void clear_transactions()
+    {
+        m_transactions.for_each([this](uint64_t key, Transaction& transaction) {
+            erase_transaction(key, transaction);
+        });
+    }
+
+    void retransmit(uint64_t key)
+    {
+        Transaction* transaction = m_transactions.find(key);
+        if (transaction == nullptr)
+        {
+            return;
+        }
+        ESP_LOGI(TAG, "Retransmitting %.*s", static_cast<int>(transaction->method.size()), transaction->method.data());
+        TxBufferT& tx_buffer = m_socket.get_new_tx_buf();
+        tx_buffer << transaction->message;
+        m_socket.send_buffered_data();
+
+        // INVITE backs off without limit, the other requests up to T2
+        transaction->interval = (transaction->method == INVITE) ? transaction->interval * 2 : std::min(transaction->interval * 2, T2);
+        m_timer_wheel->start(transaction->retransmit_timer, transaction->interval, [this, key]() {
+            retransmit(key);
+        });
+    }
+
+    void transaction_timed_out(uint64_t key)
+    {
+        Transaction* transaction = m_transactions.find(key);
+        if (transaction == nullptr)
+        {
+            return;
+        }
+        ESP_LOGW(TAG, "No response to %.*s", static_cast<int>(transaction->method.size()), transaction->method.data());
+        erase_transaction(key, *transaction);
+        m_sm.process_event(ev_reply_timeout {});
+    }
+
+    [[nodiscard]] bool has_announcement() const
+    {
+        return (m_announcement != nullptr) && (m_announcement->frame_count() > 0);
+    }
+
+    void end_dialog(uint64_t dialog_key)
+    {
+        m_dialogs.erase(dialog_key);
+    }
+
+    void update_templates()
+    {
+        m_templates.update(m_user, m_server_ip, m_my_ip, m_local_port, m_local_rtp_port, has_announcement());
+    }
+
     bool read_param(const std::string& line, const std::string& param_name, std::string& output)
     {
         const std::string param(param_name + "=\"");
@@ -648,78 +1354,201 @@ private:
         return true;
     }
 
-    void compute_auth_response(const std::string& method, const std::string& uri)
+    /**
+     * Stores the challenge of a 401 or 407 response, the nonce count starts again with a new cnonce
+     *
+     * SHA-256 is preferred, if the server offers it and it is supported.
+     */
+    static void set_challenge(DigestChallenge& challenge, const SipPacket& packet, bool proxy)
     {
-        std::string ha1_text;
-        std::string ha2_text;
-        std::array<unsigned char, 16> hash {};
+        challenge.algorithm = DigestAlgorithm::MD5;
+        if (SHA_256_SUPPORTED && !packet.get_challenge(DigestAlgorithm::SHA_256).nonce.empty())
+        {
+            challenge.algorithm = DigestAlgorithm::SHA_256;
+        }
+        const SipPacket::Challenge& offered = packet.get_challenge(challenge.algorithm);
+        challenge.realm = offered.realm;
+        challenge.nonce = offered.nonce;
+        challenge.qop_auth = has_qop_auth(offered.qop);
+        challenge.proxy = proxy;
+        challenge.nonce_count = 0;
+        const std::array<char, 8> cnonce = to_hex_word(static_cast<uint32_t>(std::rand()));
+        challenge.cnonce.assign(cnonce.data(), cnonce.size());
+    }
 
-        m_response = "";
-        std::string data = m_user + ":" + m_realm + ":" + m_pwd;
+    /**
+     * Returns true if "auth" is one of the comma separated qop options, e.g. "auth,auth-int"
+     */
+    static bool has_qop_auth(std::string_view qop)
+    {
+        while (!qop.empty())
+        {
+            const size_t comma_pos = qop.find(',');
+            std::string_view option = qop.substr(0, comma_pos);
+            while (!option.empty() && (option.front() == ' '))
+            {
+                option.remove_prefix(1);
+            }
+            while (!option.empty() && (option.back() == ' '))
+            {
+                option.remove_suffix(1);
+            }
+            if (option == "auth")
+            {
+                return true;
+            }
+            qop.remove_prefix((comma_pos == std::string_view::npos) ? qop.size() : comma_pos + 1);
+        }
+        return false;
+    }
 
-        m_md5.start();
-        m_md5.update(data);
-        m_md5.finish(hash);
-        to_hex(ha1_text, hash);
-        ESP_LOGV(TAG, "Calculating md5 for : %s", data.c_str());
-        ESP_LOGV(TAG, "Hex ha1 is %s", ha1_text.c_str());
+    /**
+     * Computes the response for the last challenge, if its nonce can be used again (qop=auth), otherwise
+     * the request is sent without credentials
+     */
+    void reuse_auth(std::string_view method, std::string_view uri, DigestChallenge& challenge)
+    {
+        if (challenge.qop_auth && !challenge.nonce.empty())
+        {
+            compute_auth_response(method, uri, challenge);
+        }
+        else
+        {
+            challenge.authorized = false;
+        }
+    }
+
+    /**
+     * Computes the digest response (RFC 2617) for the request
+     *
+     * HA1 only depends on the credentials and the realm, so it is cached until the credentials change.
+     * With qop=auth the nonce count is incremented for each request.
+     */
+    void compute_auth_response(std::string_view method, std::string_view uri, DigestChallenge& challenge)
+    {
+        if constexpr (SHA_256_SUPPORTED)
+        {
+            if (challenge.algorithm == DigestAlgorithm::SHA_256)
+            {
+                compute_auth_response(m_sha256, method, uri, challenge);
+                return;
+            }
+        }
+        compute_auth_response(m_md5, method, uri, challenge);
+    }
 
-        data = method + ":" + uri;
+    template <typename DigestT>
+    void compute_auth_response(DigestT& digest, std::string_view method, std::string_view uri, DigestChallenge& challenge)
+    {
+        std::array<unsigned char, DigestT::DIGEST_SIZE> hash {};
 
-        m_md5.start();
-        m_md5.update(data);
-        m_md5.finish(hash);
-        to_hex(ha2_text, hash);
-        ESP_LOGV(TAG, "Calculating md5 for : %s", data.c_str());
-        ESP_LOGV(TAG, "Hex ha2 is %s", ha2_text.c_str());
+        if (!m_ha1_valid || (m_ha1_algorithm != challenge.algorithm) || (m_ha1_realm != challenge.realm))
+        {
+            digest.start();
+            digest.update(m_user, ":", challenge.realm, ":", m_pwd);
+            digest.finish(hash);
+            m_ha1.assign(hash);
+            m_ha1_algorithm = challenge.algorithm;
+            m_ha1_realm = challenge.realm;
+            m_ha1_valid = true;
+            ESP_LOGV(TAG, "Hex ha1 is %.*s", static_cast<int>(m_ha1.view().size()), m_ha1.view().data());
+        }
 
-        data = ha1_text + ":" + m_nonce + ":" + ha2_text;
+        digest.start();
+        digest.update(method, ":", uri);
+        digest.finish(hash);
+        const std::array<char, 2 * DigestT::DIGEST_SIZE> ha2 = to_hex(hash);
+        ESP_LOGV(TAG, "Hex ha2 is %.*s", static_cast<int>(ha2.size()), ha2.data());
 
-        m_md5.start();
-        m_md5.update(data);
-        m_md5.finish(hash);
-        to_hex(m_response, hash);
-        ESP_LOGV(TAG, "Calculating md5 for : %s", data.c_str());
-        ESP_LOGV(TAG, "Hex response is %s", m_response.c_str());
+        digest.start();
+        if (challenge.qop_auth)
+        {
+            challenge.nonce_count++;
+            const std::array<char, 8> nonce_count = to_hex_word(challenge.nonce_count);
+            digest.update(m_ha1.view(), ":", challenge.nonce, ":", std::string_view(nonce_count.data(), nonce_count.size()), ":", challenge.cnonce, ":auth:", std::string_view(ha2.data(), ha2.size()));
+        }
+        else
+        {
+            digest.update(m_ha1.view(), ":", challenge.nonce, ":", std::string_view(ha2.data(), ha2.size()));
+        }
+        digest.finish(hash);
+        challenge.response.assign(hash);
+        challenge.authorized = true;
+        ESP_LOGV(TAG, "Hex response is %.*s", static_cast<int>(challenge.response.view().size()), challenge.response.view().data());
     }
 
-    void to_hex(std::string& dest, const std::array<unsigned char, 16>& data)
+    /**
+     * Adds the (Proxy-)Authorization header line with the response computed last for the challenge
+     */
+    void add_authorization(TxBufferT& tx_buffer, std::string_view header, const DigestChallenge& challenge, std::string_view uri, bool with_algorithm)
     {
-        static const std::array<char, 16> hexits { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
-
-        dest = "";
-        dest.reserve(data.size() * 2 + 1);
-        for (auto byte : data)
+        tx_buffer << header << m_templates.authorization_prefix() << challenge.realm << "\", nonce=\"" << challenge.nonce << "\", uri=\"" << uri << "\", ";
+        // without the parameter MD5 is assumed
+        if (with_algorithm || (challenge.algorithm != DigestAlgorithm::MD5))
         {
-            dest.push_back(hexits[byte >> 4]);
-            dest.push_back(hexits[byte & 0x0F]);
+            tx_buffer << "algorithm=" << digest_algorithm_name(challenge.algorithm) << ", ";
         }
+        tx_buffer << "response=\"" << challenge.response.view() << "\"";
+        if (challenge.qop_auth)
+        {
+            const std::array<char, 8> nonce_count = to_hex_word(challenge.nonce_count);
+            tx_buffer << ", qop=auth, nc=" << std::string_view(nonce_count.data(), nonce_count.size()) << ", cnonce=\"" << challenge.cnonce << "\"";
+        }
+        tx_buffer << "\r\n";
+    }
+
+    /**
+     * Returns the value as 8 hex digits, e.g. the nonce count 00000001
+     */
+    static std::array<char, 8> to_hex_word(uint32_t value)
+    {
+        const std::array<unsigned char, 4> bytes { static_cast<unsigned char>(value >> 24), static_cast<unsigned char>(value >> 16), static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value) };
+        return to_hex(bytes);
     }
 
     SocketT m_socket;
-    SocketT m_rtp_socket;
+    RtpSocketT m_rtp_socket;
+    /** Set by the user, played by the media state of each call */
+    const Announcement* m_announcement { nullptr };
     Md5T m_md5;
+    DigestOrNone<Sha256T> m_sha256;
     std::string m_server_ip;
 
     std::string m_user;
     std::string m_pwd;
     std::string m_my_ip;
 
+    SipMessageTemplates m_templates;
+
     std::string m_uri;
     std::string m_to_uri;
     std::string m_to_contact;
     std::string m_to_tag;
 
-    SipPacket::RecordRouteT m_record_route;
+    std::array<std::string, std::tuple_size_v<SipPacket::RecordRouteT>> m_record_route;
+
+    /** Drives all timers, declared before them so that it outlives them */
+    std::shared_ptr<TimerWheel> m_timer_wheel;
+    /** Declared after the timer wheel, its timers are cancelled when it is released */
+    std::unique_ptr<CallMedia> m_media;
+    /** Keyed by Call-ID, From tag, Via branch and CSeq method */
+    FixedHashTable<Transaction, 16> m_transactions;
+    /** Capacity of the last finished transaction, reused by the next one */
+    std::string m_spare_message;
+    /** Keyed by Call-ID */
+    FixedHashTable<Dialog, 8> m_dialogs;
 
     uint32_t m_sip_sequence_number;
     uint32_t m_call_id;
 
     // auth stuff
-    std::string m_response;
-    std::string m_realm;
-    std::string m_nonce;
-    bool m_proxy_auth { false };
+    DigestChallenge m_register_auth;
+    /** Used for INVITE and CANCEL */
+    DigestChallenge m_invite_auth;
+    HexDigest m_ha1;
+    std::string m_ha1_realm;
+    DigestAlgorithm m_ha1_algorithm { DigestAlgorithm::MD5 };
+    bool m_ha1_valid { false };
 
     uint32_t m_tag;
     uint32_t m_branch;
@@ -728,24 +1557,38 @@ private:
     std::string m_caller_display;
 
     uint32_t m_sdp_session_id { 0 };
-    Buffer<1024> m_tx_sdp_buffer;
+    /** "<session id> <session version>" of the sdp origin line */
+    Buffer<24> m_sdp_session_ids;
 
     std::function<void(SipClientT&, const SipClientEvent&)> m_event_handler;
+    std::function<void(SipClientT&, std::string_view, uint8_t)> m_audio_handler;
 
     SmlSmT& m_sm;
 
     asio::io_context& m_io_context;
-    asio::steady_timer m_timer;
-    asio::steady_timer m_command_timeout_timer;
-    asio::steady_timer m_reregister_timer;
+    TimerWheel::Timer m_timer;
+    TimerWheel::Timer m_reregister_timer;
 
     SipClientT& m_sip_client;
 
-    static constexpr const uint16_t LOCAL_PORT = 5060;
-    static constexpr const char* TRANSPORT_LOWER = "udp";
-    static constexpr const char* TRANSPORT_UPPER = "UDP";
+    const uint16_t m_local_port;
+    const uint16_t m_local_rtp_port;
 
     static constexpr uint32_t SOCKET_RX_TIMEOUT_MSEC = 200;
-    static constexpr uint16_t LOCAL_RTP_PORT = 7078;
+    /** RFC 3261 timer values */
+    static constexpr asio::chrono::milliseconds T1 { 500 };
+    static constexpr asio::chrono::milliseconds T2 { 4000 };
+    static constexpr asio::chrono::milliseconds TRANSACTION_TIMEOUT { 64 * T1.count() };
+    static constexpr asio::chrono::seconds MEDIA_TIMEOUT { 30 };
+    /** Packetization interval of the received audio */
+    static constexpr asio::chrono::milliseconds FRAME_DURATION { 20 };
+    static constexpr asio::chrono::milliseconds MAX_PLAYOUT_LAG { 100 };
+
+    static constexpr std::string_view REGISTER = "REGISTER";
+    static constexpr std::string_view INVITE = "INVITE";
+    static constexpr std::string_view CANCEL = "CANCEL";
+    static constexpr std::string_view AUTHORIZATION = "Authorization: ";
+    static constexpr std::string_view PROXY_AUTHORIZATION = "Proxy-Authorization: ";
+    static constexpr bool SHA_256_SUPPORTED = !std::is_void_v<Sha256T>;
     static constexpr const char* TAG = "SipClient";
 };
@@ -0,0 +1,192 @@
+/*
+   Copyright 2017-2019 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "sdp.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Pre-rendered parts of the sent SIP requests
+ *
+ * Most of each request only depends on the user, the server ip and the own ip.
+ * These parts are rendered once by update(), whenever one of them changes.
+ * When sending, only the variable fields (CSeq, branch, tag, Call-ID, auth response)
+ * are filled in between these parts.
+ */
+class SipMessageTemplates
+{
+public:
+    /**
+     * \param[in] send_audio Offer to send audio (a=sendrecv), e.g. an announcement, instead of only receiving it
+     */
+    void update(std::string_view user, std::string_view server_ip, std::string_view my_ip, uint16_t local_port, uint16_t local_rtp_port, bool send_audio)
+    {
+        const std::string port = std::to_string(local_port);
+        const std::string aor = std::string("<sip:").append(user).append("@").append(server_ip).append(">");
+
+        m_register_uri.assign("sip:").append(server_ip);
+        m_user_uri.assign("sip:").append(user).append("@").append(server_ip);
+
+        m_register_request_line.assign("REGISTER ").append(m_register_uri).append(" SIP/2.0\r\n");
+        m_register_to_line.assign("To: <").append(m_user_uri).append(">\r\n");
+        m_register_from_prefix.assign("From: ").append(aor).append(";tag=");
+        m_from_prefix.assign("From: \"").append(user).append("\" ").append(aor).append(";tag=");
+        m_from_display_suffix.assign("\" ").append(aor).append(";tag=");
+
+        m_call_id_suffix.assign("@").append(my_ip).append("\r\n");
+        m_via_prefix.assign("Via: SIP/2.0/").append(TRANSPORT_UPPER).append(" ").append(my_ip).append(":").append(port).append(";branch=").append(BRANCH_PREFIX);
+
+        m_contact_line.assign("Contact: \"").append(user).append("\" <sip:").append(user).append("@").append(my_ip).append(":").append(port).append(";transport=").append(TRANSPORT_LOWER).append(">\r\n");
+        m_authorization_prefix.assign("Digest username=\"").append(user).append("\", realm=\"");
+
+        m_sdp_origin_prefix.assign("v=0\r\no=").append(user).append(" ");
+        m_sdp_session_suffix.assign(" IN IP4 ").append(my_ip).append("\r\n");
+        m_sdp_session_suffix.append("s=sip-client/0.0.1\r\n");
+        m_sdp_session_suffix.append("c=IN IP4 ").append(my_ip).append("\r\n");
+        m_sdp_session_suffix.append("t=0 0\r\n");
+
+        m_sdp_origin_suffix.assign(m_sdp_session_suffix);
+        m_sdp_origin_suffix.append("m=audio ").append(std::to_string(local_rtp_port)).append(" RTP/AVP");
+        for (const SdpCodec& codec : SDP_CODECS)
+        {
+            m_sdp_origin_suffix.append(" ").append(std::to_string(codec.payload_type));
+        }
+        m_sdp_origin_suffix.append("\r\n");
+        m_sdp_origin_suffix.append(send_audio ? "a=sendrecv\r\n" : "a=recvonly\r\n");
+        for (const SdpCodec& codec : SDP_CODECS)
+        {
+            // the static payload types do not need an rtpmap (RFC 3551)
+            if (codec.payload_type >= 96)
+            {
+                m_sdp_origin_suffix.append("a=rtpmap:").append(std::to_string(codec.payload_type)).append(" ").append(codec.encoding_name).append("/").append(std::to_string(codec.clock_rate)).append("\r\n");
+            }
+            if (!codec.fmtp.empty())
+            {
+                m_sdp_origin_suffix.append("a=fmtp:").append(std::to_string(codec.payload_type)).append(" ").append(codec.fmtp).append("\r\n");
+            }
+        }
+        m_sdp_origin_suffix.append("a=ptime:20\r\n");
+    }
+
+    /** e.g. sip:192.168.179.1 */
+    [[nodiscard]] const std::string& register_uri() const
+    {
+        return m_register_uri;
+    }
+
+    /** e.g. sip:620@192.168.179.1 */
+    [[nodiscard]] const std::string& user_uri() const
+    {
+        return m_user_uri;
+    }
+
+    [[nodiscard]] const std::string& register_request_line() const
+    {
+        return m_register_request_line;
+    }
+
+    [[nodiscard]] const std::string& register_to_line() const
+    {
+        return m_register_to_line;
+    }
+
+    /** From line of a REGISTER up to the tag value */
+    [[nodiscard]] const std::string& register_from_prefix() const
+    {
+        return m_register_from_prefix;
+    }
+
+    /** From line with the user as display name up to the tag value */
+    [[nodiscard]] const std::string& from_prefix() const
+    {
+        return m_from_prefix;
+    }
+
+    /** Rest of a From line after a custom display name up to the tag value */
+    [[nodiscard]] const std::string& from_display_suffix() const
+    {
+        return m_from_display_suffix;
+    }
+
+    /** Rest of the Call-ID line after the call id number */
+    [[nodiscard]] const std::string& call_id_suffix() const
+    {
+        return m_call_id_suffix;
+    }
+
+    /** Via line up to the branch value */
+    [[nodiscard]] const std::string& via_prefix() const
+    {
+        return m_via_prefix;
+    }
+
+    [[nodiscard]] const std::string& contact_line() const
+    {
+        return m_contact_line;
+    }
+
+    /** Authorization header value up to the realm value */
+    [[nodiscard]] const std::string& authorization_prefix() const
+    {
+        return m_authorization_prefix;
+    }
+
+    /** SDP up to the session id */
+    [[nodiscard]] const std::string& sdp_origin_prefix() const
+    {
+        return m_sdp_origin_prefix;
+    }
+
+    /** SDP after the session version up to the end */
+    [[nodiscard]] const std::string& sdp_origin_suffix() const
+    {
+        return m_sdp_origin_suffix;
+    }
+
+    /** SDP after the session version up to the media sections, for an answer */
+    [[nodiscard]] const std::string& sdp_session_suffix() const
+    {
+        return m_sdp_session_suffix;
+    }
+
+    static constexpr const char* TRANSPORT_LOWER = "udp";
+    static constexpr const char* TRANSPORT_UPPER = "UDP";
+    /** Magic cookie of RFC 3261 branches, followed by the branch number */
+    static constexpr const char* BRANCH_PREFIX = "z9hG4bK-";
+    static constexpr const char* MAX_FORWARDS_AND_USER_AGENT_LINES = "Max-Forwards: 70\r\n"
+                                                                     "User-Agent: sip-client/0.0.1\r\n";
+    static constexpr const char* ALLOW_LINE = "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\n";
+
+private:
+    std::string m_register_uri;
+    std::string m_user_uri;
+    std::string m_register_request_line;
+    std::string m_register_to_line;
+    std::string m_register_from_prefix;
+    std::string m_from_prefix;
+    std::string m_from_display_suffix;
+    std::string m_call_id_suffix;
+    std::string m_via_prefix;
+    std::string m_contact_line;
+    std::string m_authorization_prefix;
+    std::string m_sdp_origin_prefix;
+    std::string m_sdp_origin_suffix;
+    std::string m_sdp_session_suffix;
+};
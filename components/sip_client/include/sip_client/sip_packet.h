@@ -16,9 +16,14 @@
 
 #pragma once
 
+#include "digest.h"
 #include "esp_log.h"
+#include "sip_scanner.h"
+
 #include <array>
+#include <charconv>
 #include <cstring>
+#include <string_view>
 
 class SipPacket
 {
@@ -49,13 +54,19 @@ public:
     enum class ContentType
     {
         APPLICATION_DTMF_RELAY,
+        APPLICATION_SDP,
         UNKNOWN
     };
 
-    using ViaT = std::array<std::string, 5>;
-    using RecordRouteT = std::array<std::string, 5>;
+    using ViaT = std::array<std::string_view, 5>;
+    using RecordRouteT = std::array<std::string_view, 5>;
 
-    SipPacket(char* input_buffer, size_t input_buffer_length)
+    /**
+     * All parsed header values are views into the given input buffer, no copies are made.
+     * So the input buffer must outlive this packet and must not be modified afterwards.
+     * The input buffer itself is never modified by the parser.
+     */
+    SipPacket(const char* input_buffer, size_t input_buffer_length)
         : m_buffer(input_buffer)
         , m_buffer_length(input_buffer_length)
     {
@@ -63,6 +74,7 @@ public:
 
     bool parse()
     {
+        m_index.build(m_buffer, m_buffer_length);
         const bool result = parse_header();
         if (!result)
         {
@@ -77,6 +89,19 @@ public:
         return m_status;
     }
 
+    /**
+     * Numeric status code of a response, 0 for a request
+     */
+    [[nodiscard]] uint16_t get_status_code() const
+    {
+        return m_status_code;
+    }
+
+    [[nodiscard]] bool is_response() const
+    {
+        return m_status_code != 0;
+    }
+
     [[nodiscard]] Method get_method() const
     {
         return m_method;
@@ -92,17 +117,28 @@ public:
         return m_content_length;
     }
 
-    [[nodiscard]] std::string get_nonce() const
+    /**
+     * Digest challenge of a WWW-Authenticate or Proxy-Authenticate line
+     */
+    struct Challenge
     {
-        return m_nonce;
-    }
+        std::string_view realm;
+        std::string_view nonce;
+        /** e.g. "auth" or "auth,auth-int", empty if not offered */
+        std::string_view qop;
+    };
 
-    [[nodiscard]] std::string get_realm() const
+    /**
+     * Returns the challenge for the algorithm, the nonce is empty if the server did not offer the algorithm
+     *
+     * A server may offer several algorithms with one authenticate line each (RFC 8760).
+     */
+    [[nodiscard]] const Challenge& get_challenge(DigestAlgorithm algorithm) const
     {
-        return m_realm;
+        return m_challenges[static_cast<size_t>(algorithm)];
     }
 
-    [[nodiscard]] std::string get_contact() const
+    [[nodiscard]] std::string_view get_contact() const
     {
         return m_contact;
     }
@@ -112,27 +148,49 @@ public:
         return m_contact_expires;
     }
 
-    [[nodiscard]] std::string get_to_tag() const
+    [[nodiscard]] std::string_view get_to_tag() const
     {
         return m_to_tag;
     }
 
-    [[nodiscard]] std::string get_cseq() const
+    [[nodiscard]] std::string_view get_from_tag() const
+    {
+        return m_from_tag;
+    }
+
+    [[nodiscard]] std::string_view get_cseq() const
     {
         return m_cseq;
     }
 
-    [[nodiscard]] std::string get_call_id() const
+    /**
+     * Method part of the CSeq header value, e.g. INVITE for "102 INVITE"
+     */
+    [[nodiscard]] std::string_view get_cseq_method() const
+    {
+        const size_t pos = m_cseq.find(' ');
+        return (pos == std::string_view::npos) ? std::string_view {} : trim_left(m_cseq.substr(pos + 1));
+    }
+
+    /**
+     * Branch parameter of the topmost Via header
+     */
+    [[nodiscard]] std::string_view get_via_branch() const
+    {
+        return m_via_branch;
+    }
+
+    [[nodiscard]] std::string_view get_call_id() const
     {
         return m_call_id;
     }
 
-    [[nodiscard]] std::string get_to() const
+    [[nodiscard]] std::string_view get_to() const
     {
         return m_to;
     }
 
-    [[nodiscard]] std::string get_from() const
+    [[nodiscard]] std::string_view get_from() const
     {
         return m_from;
     }
@@ -147,7 +205,7 @@ public:
         return m_record_route;
     }
 
-    [[nodiscard]] std::string get_p_called_party_id() const
+    [[nodiscard]] std::string_view get_p_called_party_id() const
     {
         return m_p_called_party_id;
     }
@@ -161,53 +219,83 @@ public:
     {
         return m_dtmf_duration;
     }
-    [[nodiscard]] std::string get_media() const
-    {
-        return m_media;
-    }
-    [[nodiscard]] std::string get_cip() const
+
+    /**
+     * The message body, limited by the Content-Length, e.g. the SDP of an INVITE
+     *
+     * Without a Content-Length the body is the rest of the datagram (RFC 3261 18.3),
+     * with Content-Length: 0 there is no body.
+     */
+    [[nodiscard]] std::string_view get_body() const
     {
-        return m_cip;
+        if (m_body == nullptr)
+        {
+            return {};
+        }
+        const auto available = static_cast<size_t>(m_buffer + m_buffer_length - m_body);
+        return { m_body, (!m_has_content_length || (m_content_length > available)) ? available : m_content_length };
     }
 
 private:
+    enum class HeaderType
+    {
+        VIA,
+        FROM,
+        TO,
+        CALL_ID,
+        C_SEQ,
+        CONTACT,
+        CONTENT_TYPE,
+        CONTENT_LENGTH,
+        RECORD_ROUTE,
+        P_CALLED_PARTY_ID,
+        WWW_AUTHENTICATE,
+        PROXY_AUTHENTICATE,
+        UNKNOWN
+    };
+
     bool parse_header()
     {
-        char* start_position = m_buffer;
-        char* end_position = strstr(start_position, LINE_ENDING);
-
         m_method = Method::UNKNOWN;
         m_status = Status::UNKNOWN;
+        m_status_code = 0;
         m_contact_expires = 0;
         m_content_type = ContentType::UNKNOWN;
         m_content_length = 0;
-        m_cseq = "";
-        m_call_id = "";
-        m_to = "";
-        m_from = "";
-        m_via.fill("");
-        m_record_route.fill("");
-        m_p_called_party_id = "";
+        m_has_content_length = false;
+        m_cseq = {};
+        m_call_id = {};
+        m_to = {};
+        m_to_tag = {};
+        m_from = {};
+        m_from_tag = {};
+        m_via.fill({});
+        m_via_branch = {};
+        m_challenges.fill({});
+        m_record_route.fill({});
+        m_p_called_party_id = {};
         m_dtmf_signal = ' ';
         m_dtmf_duration = 0;
-        m_cip = "";
-        m_media = "";
         m_body = nullptr;
 
+        const char* const buffer_end = m_buffer + m_buffer_length;
+        const char* start_position = m_buffer;
+        const char* end_position = find_line_ending(start_position, buffer_end);
+
         if (end_position == nullptr)
         {
-            ESP_LOGW(TAG, "No line ending found in %s", m_buffer);
+            ESP_LOGW(TAG, "No line ending found in %.*s", static_cast<int>(m_buffer_length), m_buffer);
             return false;
         }
 
         uint32_t line_number = 0;
         do
         {
-            auto length = static_cast<size_t>(end_position - start_position);
-            if (length == 0) // line only contains the line ending
+            const std::string_view line(start_position, static_cast<size_t>(end_position - start_position));
+            if (line.empty()) // line only contains the line ending
             {
                 ESP_LOGV(TAG, "Valid end of header detected");
-                if (end_position + LINE_ENDING_LEN >= m_buffer + m_buffer_length)
+                if (end_position + LINE_ENDING_LEN >= buffer_end)
                 {
                     // no remaining data in buffer, so no body
                     m_body = nullptr;
@@ -218,134 +306,139 @@ private:
                 }
                 return true;
             }
-            char* next_start_position = end_position + LINE_ENDING_LEN;
             line_number++;
+            ESP_LOGV(TAG, "Parsing line: %.*s", static_cast<int>(line.size()), line.data());
 
-            // create a proper null terminated c string
-            // from here on string functions may be used!
-            memset(end_position, 0, LINE_ENDING_LEN);
-            ESP_LOGV(TAG, "Parsing line: %s", start_position);
-
-            if (strstr(start_position, SIP_2_0_SPACE) == start_position)
+            if (line_number == 1)
             {
-                const long code = strtol(start_position + strlen(SIP_2_0_SPACE), nullptr, 10);
-                ESP_LOGV(TAG, "Detect status %ld", code);
-                m_status = convert_status(code);
+                parse_start_line(line);
             }
-            else if ((strncmp(WWW_AUTHENTICATE, start_position, strlen(WWW_AUTHENTICATE)) == 0)
-                || (strncmp(PROXY_AUTHENTICATE, start_position, strlen(PROXY_AUTHENTICATE)) == 0))
+            else
             {
-                ESP_LOGV(TAG, "Detect authenticate line");
-                // read realm and nonce from authentication line
-                if (!read_param(start_position, REALM, m_realm))
-                {
-                    ESP_LOGW(TAG, "Failed to read realm in authenticate line");
-                }
-                if (!read_param(start_position, NONCE, m_nonce))
-                {
-                    ESP_LOGW(TAG, "Failed to read nonce in authenticate line");
-                }
-                ESP_LOGI(TAG, "Realm is %s and nonce is %s", m_realm.c_str(), m_nonce.c_str());
+                parse_header_line(line);
             }
-            else if (strncmp(CONTACT, start_position, strlen(CONTACT)) == 0)
-            {
-                ESP_LOGV(TAG, "Detect contact line");
-                start_position = start_position + strlen(CONTACT);
 
-                const char* open_pos = strstr(start_position, "<");
-                const char* close_pos = strstr(start_position, ">");
+            // go to next line
+            start_position = end_position + LINE_ENDING_LEN;
+            end_position = find_line_ending(start_position, buffer_end);
+        } while (end_position != nullptr);
 
-                if ((open_pos == nullptr) || (close_pos == nullptr))
-                {
-                    ESP_LOGW(TAG, "Failed to read content of contact line");
-                }
-                else
-                {
-                    m_contact = std::string(open_pos + 1, close_pos);
-
-                    /* in the SIP 200 OK finishing a successful REGISTER, the contact line might also
-                     * contain the expire information from the server, e.g.
-                     * Contact: <...>;expires=300
-                     */
-                    const char* expires_pos = strstr(close_pos + 1, ";expires=");
-                    if (expires_pos != nullptr)
-                    {
-                        const long contact_expires = strtol(expires_pos + strlen(";expires="), nullptr, 10);
-                        if (contact_expires < 0)
-                        {
-                            ESP_LOGW(TAG, "Invalid contact expires %ld", contact_expires);
-                        }
-                        else
-                        {
-                            m_contact_expires = static_cast<uint32_t>(contact_expires);
-                        }
-                    }
-                }
-            }
-            else if (strncmp(TO, start_position, strlen(TO)) == 0)
-            {
-                ESP_LOGV(TAG, "Detect to line");
-                const char* tag_pos = strstr(start_position, ">;tag=");
-                if (tag_pos != nullptr)
-                {
-                    m_to_tag = std::string(tag_pos + strlen(">;tag="));
-                }
-                m_to = std::string(start_position + strlen(TO));
-            }
-            else if (strstr(start_position, FROM) == start_position)
-            {
-                m_from = std::string(start_position + strlen(FROM));
-            }
-            else if (strstr(start_position, VIA) == start_position)
-            {
-                append_via(std::string(start_position + strlen(VIA)));
-            }
-            else if (strstr(start_position, RECORD_ROUTE) == start_position)
-            {
-                append_record_route(std::string(start_position + strlen(RECORD_ROUTE)));
-            }
-            else if (strstr(start_position, C_SEQ) == start_position)
-            {
-                m_cseq = std::string(start_position + strlen(C_SEQ));
-            }
-            else if (strstr(start_position, CALL_ID) == start_position)
-            {
-                m_call_id = std::string(start_position + strlen(CALL_ID));
-            }
-            else if (strstr(start_position, P_CALLED_PARTY_ID) == start_position)
+        // no line only containing the line ending found :(
+        return false;
+    }
+
+    void parse_start_line(std::string_view line)
+    {
+        if (starts_with(line, SIP_2_0_SPACE))
+        {
+            const long code = to_number(line.substr(SIP_2_0_SPACE.size()));
+            ESP_LOGV(TAG, "Detect status %ld", code);
+            m_status = convert_status(code);
+            m_status_code = ((code > 0) && (code < 1000)) ? static_cast<uint16_t>(code) : 0;
+        }
+        else
+        {
+            // first line, but no response
+            m_method = convert_method(line);
+        }
+    }
+
+    void parse_header_line(std::string_view line)
+    {
+        const size_t colon_pos = m_index.find(':', line);
+        if (colon_pos == std::string_view::npos)
+        {
+            ESP_LOGV(TAG, "Ignoring line without header name");
+            return;
+        }
+        const std::string_view value = trim_left(line.substr(colon_pos + 1));
+
+        switch (classify_header(trim_right(line.substr(0, colon_pos))))
+        {
+        case HeaderType::WWW_AUTHENTICATE:
+        case HeaderType::PROXY_AUTHENTICATE:
+            ESP_LOGV(TAG, "Detect authenticate line");
+            parse_challenge(value);
+            break;
+        case HeaderType::CONTACT:
+            ESP_LOGV(TAG, "Detect contact line");
+            parse_contact(value);
+            break;
+        case HeaderType::TO:
+            ESP_LOGV(TAG, "Detect to line");
+            m_to = value;
+            read_tag(value, m_to_tag);
+            break;
+        case HeaderType::FROM:
+            m_from = value;
+            read_tag(value, m_from_tag);
+            break;
+        case HeaderType::VIA:
+            append_via(value);
+            break;
+        case HeaderType::RECORD_ROUTE:
+            append_record_route(value);
+            break;
+        case HeaderType::C_SEQ:
+            m_cseq = value;
+            break;
+        case HeaderType::CALL_ID:
+            m_call_id = value;
+            break;
+        case HeaderType::P_CALLED_PARTY_ID:
+            m_p_called_party_id = value;
+            break;
+        case HeaderType::CONTENT_TYPE:
+            m_content_type = convert_content_type(value);
+            break;
+        case HeaderType::CONTENT_LENGTH:
+        {
+            const long content_length = to_number(value);
+            if (content_length < 0)
             {
-                m_p_called_party_id = std::string(start_position + strlen(P_CALLED_PARTY_ID));
+                ESP_LOGW(TAG, "Invalid content length %ld", content_length);
             }
-            else if (strstr(start_position, CONTENT_TYPE) == start_position)
+            else
             {
-                m_content_type = convert_content_type(start_position + strlen(CONTENT_TYPE));
+                m_content_length = static_cast<uint32_t>(content_length);
+                m_has_content_length = true;
             }
-            else if (strstr(start_position, CONTENT_LENGTH) == start_position)
+            break;
+        }
+        case HeaderType::UNKNOWN:
+            break;
+        }
+    }
+
+    void parse_contact(std::string_view value)
+    {
+        const size_t open_pos = m_index.find('<', value);
+        const size_t close_pos = m_index.find('>', value);
+
+        if ((open_pos == std::string_view::npos) || (close_pos == std::string_view::npos) || (close_pos < open_pos))
+        {
+            ESP_LOGW(TAG, "Failed to read content of contact line");
+            return;
+        }
+        m_contact = value.substr(open_pos + 1, close_pos - open_pos - 1);
+
+        /* in the SIP 200 OK finishing a successful REGISTER, the contact line might also
+         * contain the expire information from the server, e.g.
+         * Contact: <...>;expires=300
+         */
+        std::string_view expires;
+        if (read_uri_param(value.substr(close_pos + 1), EXPIRES_PARAM, expires))
+        {
+            const long contact_expires = to_number(expires);
+            if (contact_expires < 0)
             {
-                const long content_length = strtol(start_position + strlen(CONTENT_LENGTH), nullptr, 10);
-                if (content_length < 0)
-                {
-                    ESP_LOGW(TAG, "Invalid content length %ld", content_length);
-                }
-                else
-                {
-                    m_content_length = static_cast<uint32_t>(content_length);
-                }
+                ESP_LOGW(TAG, "Invalid contact expires %ld", contact_expires);
             }
-
-            else if (line_number == 1)
+            else
             {
-                // first line, but no response
-                m_method = convert_method(start_position);
+                m_contact_expires = static_cast<uint32_t>(contact_expires);
             }
-
-            // go to next line
-            start_position = next_start_position;
-            end_position = strstr(start_position, LINE_ENDING);
-        } while (end_position != nullptr);
-
-        // no line only containing the line ending found :(
-        return false;
+        }
     }
 
     bool parse_body()
@@ -355,37 +448,35 @@ private:
             return true;
         }
 
-        char* start_position = m_body;
-        char* end_position = strstr(start_position, LINE_ENDING);
+        const char* const buffer_end = m_buffer + m_buffer_length;
+        const char* start_position = m_body;
+        const char* end_position = find_line_ending(start_position, buffer_end);
 
         if (end_position == nullptr)
         {
-            ESP_LOGW(TAG, "No line ending found in %s", m_body);
+            ESP_LOGW(TAG, "No line ending found in %.*s", static_cast<int>(buffer_end - m_body), m_body);
             return false;
         }
 
         do
         {
-            auto length = static_cast<size_t>(end_position - start_position);
-            if (length == 0) // line only contains the line ending
+            const std::string_view line(start_position, static_cast<size_t>(end_position - start_position));
+            if (line.empty()) // line only contains the line ending
             {
                 return true;
             }
+            ESP_LOGV(TAG, "Parsing line: %.*s", static_cast<int>(line.size()), line.data());
 
-            char* next_start_position = end_position + LINE_ENDING_LEN;
-
-            // create a proper null terminated c string
-            // from here on string functions may be used!
-            memset(end_position, 0, LINE_ENDING_LEN);
-            ESP_LOGV(TAG, "Parsing line: %s", start_position);
-
-            if (strstr(start_position, SIGNAL) == start_position)
+            if (starts_with(line, SIGNAL))
             {
-                m_dtmf_signal = *(start_position + strlen(SIGNAL));
+                if (line.size() > SIGNAL.size())
+                {
+                    m_dtmf_signal = line[SIGNAL.size()];
+                }
             }
-            else if (strstr(start_position, DURATION) == start_position)
+            else if (starts_with(line, DURATION))
             {
-                const long duration = strtol(start_position + strlen(DURATION), nullptr, 10);
+                const long duration = to_number(line.substr(DURATION.size()));
                 if (duration < 0)
                 {
                     ESP_LOGW(TAG, "Invalid duration %ld", duration);
@@ -395,48 +486,261 @@ private:
                     m_dtmf_duration = static_cast<uint16_t>(duration);
                 }
             }
-            else if (strstr(start_position, MEDIA) == start_position)
+
+            // go to next line
+            start_position = end_position + LINE_ENDING_LEN;
+            end_position = find_line_ending(start_position, buffer_end);
+        } while (end_position != nullptr);
+
+        return true;
+    }
+
+    /**
+     * Returns the position of the next "\r\n" in [start, end) or nullptr
+     */
+    [[nodiscard]] const char* find_line_ending(const char* start, const char* end) const
+    {
+        auto pos = static_cast<size_t>(start - m_buffer);
+        const auto end_pos = static_cast<size_t>(end - m_buffer);
+        while (pos < end_pos)
+        {
+            const size_t cr_pos = m_index.find('\r', pos, end_pos);
+            if ((cr_pos == ScannerT::npos) || (cr_pos + 1 >= end_pos))
             {
-                m_media = std::string(start_position + strlen(MEDIA));
+                return nullptr;
             }
-            else if (strstr(start_position, CIP) == start_position)
+            if (m_buffer[cr_pos + 1] == '\n')
             {
-                m_cip = std::string(start_position + strlen(CIP));
+                return m_buffer + cr_pos;
             }
+            pos = cr_pos + 1;
+        }
+        return nullptr;
+    }
 
-            // go to next line
-            start_position = next_start_position;
-            end_position = strstr(start_position, LINE_ENDING);
-        } while (end_position != nullptr);
+    /**
+     * Maps a header name (long or RFC 3261 compact form) to its type
+     *
+     * The length and the first character select the only candidate, so at most one
+     * string comparison is done per header line.
+     */
+    static HeaderType classify_header(std::string_view name)
+    {
+        if (name.empty())
+        {
+            return HeaderType::UNKNOWN;
+        }
 
-        return true;
+        HeaderType type = HeaderType::UNKNOWN;
+        std::string_view expected;
+        const char first = to_lower(name[0]);
+
+        switch (name.size())
+        {
+        case 1:
+            switch (first)
+            {
+            case 'v':
+                return HeaderType::VIA;
+            case 'f':
+                return HeaderType::FROM;
+            case 't':
+                return HeaderType::TO;
+            case 'i':
+                return HeaderType::CALL_ID;
+            case 'm':
+                return HeaderType::CONTACT;
+            case 'l':
+                return HeaderType::CONTENT_LENGTH;
+            case 'c':
+                return HeaderType::CONTENT_TYPE;
+            default:
+                return HeaderType::UNKNOWN;
+            }
+        case 2:
+            type = HeaderType::TO;
+            expected = "to";
+            break;
+        case 3:
+            type = HeaderType::VIA;
+            expected = "via";
+            break;
+        case 4:
+            if (first == 'f')
+            {
+                type = HeaderType::FROM;
+                expected = "from";
+            }
+            else
+            {
+                type = HeaderType::C_SEQ;
+                expected = "cseq";
+            }
+            break;
+        case 7:
+            if (to_lower(name[1]) == 'a')
+            {
+                type = HeaderType::CALL_ID;
+                expected = "call-id";
+            }
+            else
+            {
+                type = HeaderType::CONTACT;
+                expected = "contact";
+            }
+            break;
+        case 12:
+            if (first == 'c')
+            {
+                type = HeaderType::CONTENT_TYPE;
+                expected = "content-type";
+            }
+            else
+            {
+                type = HeaderType::RECORD_ROUTE;
+                expected = "record-route";
+            }
+            break;
+        case 14:
+            type = HeaderType::CONTENT_LENGTH;
+            expected = "content-length";
+            break;
+        case 16:
+            type = HeaderType::WWW_AUTHENTICATE;
+            expected = "www-authenticate";
+            break;
+        case 17:
+            type = HeaderType::P_CALLED_PARTY_ID;
+            expected = "p-called-party-id";
+            break;
+        case 18:
+            type = HeaderType::PROXY_AUTHENTICATE;
+            expected = "proxy-authenticate";
+            break;
+        default:
+            return HeaderType::UNKNOWN;
+        }
+
+        return iequals(name, expected) ? type : HeaderType::UNKNOWN;
     }
 
-    static bool read_param(const char* line, const char* param_name, std::string& output)
+    void parse_challenge(std::string_view value)
     {
-        const char* pos = strstr(line, param_name);
-        if (pos == nullptr)
+        std::string_view algorithm_name;
+        read_token_param(value, ALGORITHM, algorithm_name);
+        DigestAlgorithm algorithm = DigestAlgorithm::MD5;
+        if (!parse_digest_algorithm(algorithm_name, algorithm))
         {
-            return false;
+            ESP_LOGI(TAG, "Ignoring challenge with unsupported algorithm %.*s", static_cast<int>(algorithm_name.size()), algorithm_name.data());
+            return;
         }
-        if (*(pos + strlen(param_name)) != '=')
+
+        Challenge& challenge = m_challenges[static_cast<size_t>(algorithm)];
+        if (!read_param(value, REALM, challenge.realm))
         {
-            return false;
+            ESP_LOGW(TAG, "Failed to read realm in authenticate line");
+        }
+        if (!read_param(value, NONCE, challenge.nonce))
+        {
+            ESP_LOGW(TAG, "Failed to read nonce in authenticate line");
         }
+        // optional, without qop the digest of RFC 2069 is used
+        if (read_param(value, QOP, challenge.qop))
+        {
+            ESP_LOGV(TAG, "Qop is %.*s", static_cast<int>(challenge.qop.size()), challenge.qop.data());
+        }
+        ESP_LOGI(TAG, "Realm is %.*s and nonce is %.*s", static_cast<int>(challenge.realm.size()), challenge.realm.data(), static_cast<int>(challenge.nonce.size()), challenge.nonce.data());
+    }
 
-        if (*(pos + strlen(param_name) + 1) != '"')
+    /**
+     * Reads a parameter, that is usually not quoted, e.g. algorithm=SHA-256, from a header value
+     */
+    static bool read_token_param(std::string_view line, std::string_view param_name, std::string_view& output)
+    {
+        size_t pos = line.find(param_name);
+        while (pos != std::string_view::npos)
         {
-            return false;
+            const size_t value_pos = pos + param_name.size();
+            if (((pos == 0) || is_param_separator(line[pos - 1])) && (value_pos < line.size()) && (line[value_pos] == '='))
+            {
+                std::string_view value = line.substr(value_pos + 1);
+                value = value.substr(0, value.find_first_of(", \t\r"));
+                if ((value.size() >= 2) && (value.front() == '"') && (value.back() == '"'))
+                {
+                    value = value.substr(1, value.size() - 2);
+                }
+                output = value;
+                return true;
+            }
+            pos = line.find(param_name, pos + 1);
         }
+        return false;
+    }
 
-        pos += strlen(param_name) + 2;
-        const char* pos_end = strchr(pos, '"');
-        if (pos_end == nullptr)
+    /**
+     * Reads a quoted parameter, e.g. realm="fritz.box", from a header value
+     *
+     * Only the quotes are visited, the parameter name is checked in front of each opening quote.
+     */
+    [[nodiscard]] bool read_param(std::string_view line, std::string_view param_name, std::string_view& output) const
+    {
+        size_t open_pos = m_index.find('"', line);
+        while (open_pos != std::string_view::npos)
         {
-            return false;
+            const size_t close_pos = m_index.find('"', line.substr(open_pos + 1));
+            if (close_pos == std::string_view::npos)
+            {
+                return false;
+            }
+            const std::string_view before = trim_right(line.substr(0, open_pos));
+            if ((before.size() > param_name.size()) && (before.back() == '='))
+            {
+                const std::string_view name = trim_right(before.substr(0, before.size() - 1));
+                // only accept the name at the start of a parameter, e.g. do not match nonce in cnonce
+                if (ends_with(name, param_name)
+                    && ((name.size() == param_name.size()) || is_param_separator(name[name.size() - param_name.size() - 1])))
+                {
+                    output = line.substr(open_pos + 1, close_pos);
+                    return true;
+                }
+            }
+            line.remove_prefix(open_pos + close_pos + 2);
+            open_pos = m_index.find('"', line);
         }
-        output = std::string(pos, pos_end);
-        return true;
+        return false;
+    }
+
+    /**
+     * Reads a ;name=value parameter of a header value, e.g. ;tag=abc or ;expires=300
+     */
+    bool read_uri_param(std::string_view value, std::string_view param_name, std::string_view& output) const
+    {
+        size_t pos = m_index.find(';', value);
+        while (pos != std::string_view::npos)
+        {
+            value.remove_prefix(pos + 1);
+            pos = m_index.find(';', value);
+            const std::string_view param = trim_left(value.substr(0, pos));
+            if (starts_with(param, param_name))
+            {
+                output = trim_right(param.substr(param_name.size()));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Reads the tag parameter of a To or From header value, e.g. <sip:620@192.168.179.1>;tag=abc
+     */
+    void read_tag(std::string_view value, std::string_view& output) const
+    {
+        const size_t close_pos = m_index.find('>', value);
+        if (close_pos != std::string_view::npos)
+        {
+            value.remove_prefix(close_pos + 1);
+        }
+        read_uri_param(value, TAG_PARAM, output);
     }
 
     [[nodiscard]] static Status convert_status(long code)
@@ -465,38 +769,109 @@ private:
         return Status::UNKNOWN;
     }
 
-    static Method convert_method(const char* input)
+    static Method convert_method(std::string_view input)
     {
-        if (strstr(input, NOTIFY) == input)
+        if (starts_with(input, NOTIFY))
         {
             return Method::NOTIFY;
         }
-        if (strstr(input, BYE) == input)
+        if (starts_with(input, BYE))
         {
             return Method::BYE;
         }
-        if (strstr(input, INFO) == input)
+        if (starts_with(input, INFO))
         {
             return Method::INFO;
         }
-        if (strstr(input, INVITE) == input)
+        if (starts_with(input, INVITE))
         {
             return Method::INVITE;
         }
         return Method::UNKNOWN;
     }
 
-    static ContentType convert_content_type(const char* input)
+    static ContentType convert_content_type(std::string_view input)
     {
-        if (strstr(input, APPLICATION_DTMF_RELAY) == input)
+        if (starts_with(input, APPLICATION_DTMF_RELAY))
         {
             return ContentType::APPLICATION_DTMF_RELAY;
         }
+        if (starts_with(input, APPLICATION_SDP))
+        {
+            return ContentType::APPLICATION_SDP;
+        }
         return ContentType::UNKNOWN;
     }
 
-    void append_via(const std::string& via)
+    static long to_number(std::string_view input)
+    {
+        input = trim_left(input);
+        long value = 0;
+        const auto result = std::from_chars(input.data(), input.data() + input.size(), value);
+        return (result.ec == std::errc()) ? value : 0;
+    }
+
+    static bool starts_with(std::string_view input, std::string_view prefix)
+    {
+        return input.substr(0, prefix.size()) == prefix;
+    }
+
+    static bool ends_with(std::string_view input, std::string_view suffix)
+    {
+        return (input.size() >= suffix.size()) && (input.substr(input.size() - suffix.size()) == suffix);
+    }
+
+    static bool is_param_separator(char c)
+    {
+        return (c == ' ') || (c == ',') || (c == '\t');
+    }
+
+    static char to_lower(char c)
     {
+        return ((c >= 'A') && (c <= 'Z')) ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    static bool iequals(std::string_view input, std::string_view lower_case)
+    {
+        if (input.size() != lower_case.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < input.size(); i++)
+        {
+            if (to_lower(input[i]) != lower_case[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static std::string_view trim_left(std::string_view input)
+    {
+        while (!input.empty() && ((input.front() == ' ') || (input.front() == '\t')))
+        {
+            input.remove_prefix(1);
+        }
+        return input;
+    }
+
+    static std::string_view trim_right(std::string_view input)
+    {
+        while (!input.empty() && ((input.back() == ' ') || (input.back() == '\t')))
+        {
+            input.remove_suffix(1);
+        }
+        return input;
+    }
+
+    void append_via(std::string_view via)
+    {
+        if (m_via[0].empty())
+        {
+            // the topmost via identifies the transaction
+            read_uri_param(via, BRANCH_PARAM, m_via_branch);
+        }
         for (auto& v : m_via)
         {
             if (v.empty())
@@ -507,7 +882,7 @@ private:
         }
     }
 
-    void append_record_route(const std::string& record_route)
+    void append_record_route(std::string_view record_route)
     {
         for (auto& rr : m_record_route)
         {
@@ -519,60 +894,57 @@ private:
         }
     }
 
-    char* m_buffer;
+    const char* m_buffer;
     const size_t m_buffer_length;
 
     Status m_status { Status::UNKNOWN };
     Method m_method { Method::UNKNOWN };
     ContentType m_content_type { ContentType::UNKNOWN };
     uint32_t m_content_length { 0 };
+    bool m_has_content_length { false };
 
-    std::string m_realm;
-    std::string m_nonce;
-    std::string m_contact;
+    std::array<Challenge, DIGEST_ALGORITHM_COUNT> m_challenges;
+    std::string_view m_contact;
     uint32_t m_contact_expires {};
-    std::string m_to_tag;
-    std::string m_cseq;
-    std::string m_call_id;
-    std::string m_to;
-    std::string m_from;
+    uint16_t m_status_code { 0 };
+    std::string_view m_to_tag;
+    std::string_view m_from_tag;
+    std::string_view m_via_branch;
+    std::string_view m_cseq;
+    std::string_view m_call_id;
+    std::string_view m_to;
+    std::string_view m_from;
     ViaT m_via;
     RecordRouteT m_record_route;
-    std::string m_p_called_party_id;
-    std::string m_media;
-    std::string m_cip;
+    std::string_view m_p_called_party_id;
+
+    const char* m_body {};
 
-    char* m_body {};
+    // the largest packet received by the AsioUdpClient fits completely
+    static constexpr size_t SCANNER_CAPACITY = 2048;
+    using ScannerT = SipDelimiterIndex<SCANNER_CAPACITY>;
+    ScannerT m_index;
 
     uint16_t m_dtmf_duration {};
     char m_dtmf_signal {};
 
-    static constexpr const char* LINE_ENDING = "\r\n";
     static constexpr size_t LINE_ENDING_LEN = 2;
 
     static constexpr const char* TAG = "SipPacket";
-    static constexpr const char* SIP_2_0_SPACE = "SIP/2.0 ";
-    static constexpr const char* WWW_AUTHENTICATE = "WWW-Authenticate";
-    static constexpr const char* PROXY_AUTHENTICATE = "Proxy-Authenticate";
-    static constexpr const char* CONTACT = "Contact: ";
-    static constexpr const char* TO = "To: ";
-    static constexpr const char* FROM = "From: ";
-    static constexpr const char* VIA = "Via: ";
-    static constexpr const char* RECORD_ROUTE = "Record-Route: ";
-    static constexpr const char* P_CALLED_PARTY_ID = "P-Called-Party-ID: ";
-    static constexpr const char* C_SEQ = "CSeq: ";
-    static constexpr const char* CALL_ID = "Call-ID: ";
-    static constexpr const char* CONTENT_TYPE = "Content-Type: ";
-    static constexpr const char* CONTENT_LENGTH = "Content-Length: ";
-    static constexpr const char* REALM = "realm";
-    static constexpr const char* NONCE = "nonce";
-    static constexpr const char* NOTIFY = "NOTIFY ";
-    static constexpr const char* BYE = "BYE ";
-    static constexpr const char* INFO = "INFO ";
-    static constexpr const char* INVITE = "INVITE ";
-    static constexpr const char* APPLICATION_DTMF_RELAY = "application/dtmf-relay";
-    static constexpr const char* SIGNAL = "Signal=";
-    static constexpr const char* DURATION = "Duration=";
-    static constexpr const char* MEDIA = "m=";
-    static constexpr const char* CIP = "c=IN IP4 ";
+    static constexpr std::string_view SIP_2_0_SPACE = "SIP/2.0 ";
+    static constexpr std::string_view REALM = "realm";
+    static constexpr std::string_view NONCE = "nonce";
+    static constexpr std::string_view QOP = "qop";
+    static constexpr std::string_view ALGORITHM = "algorithm";
+    static constexpr std::string_view EXPIRES_PARAM = "expires=";
+    static constexpr std::string_view TAG_PARAM = "tag=";
+    static constexpr std::string_view BRANCH_PARAM = "branch=";
+    static constexpr std::string_view NOTIFY = "NOTIFY ";
+    static constexpr std::string_view BYE = "BYE ";
+    static constexpr std::string_view INFO = "INFO ";
+    static constexpr std::string_view INVITE = "INVITE ";
+    static constexpr std::string_view APPLICATION_DTMF_RELAY = "application/dtmf-relay";
+    static constexpr std::string_view APPLICATION_SDP = "application/sdp";
+    static constexpr std::string_view SIGNAL = "Signal=";
+    static constexpr std::string_view DURATION = "Duration=";
 };
@@ -0,0 +1,157 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "sip_packet.h"
+#include "sip_sml_events.h"
+
+#include <array>
+#include <cstddef>
+
+/**
+ * Binds the status of a received response or the method of a received request to its event
+ */
+template <auto KEY, typename EventT>
+struct RxEvent
+{
+    static constexpr auto key = KEY;
+    using event = EventT;
+};
+
+template <typename... RxEventsT>
+struct RxEventList
+{
+};
+
+/**
+ * All events triggered by received packets
+ *
+ * A new response code or request method only needs an entry here (and a handler, see RxDispatchTable).
+ */
+using RxEvents = RxEventList<
+    RxEvent<SipPacket::Status::TRYING_100, ev_100_trying>,
+    RxEvent<SipPacket::Status::SESSION_PROGRESS_183, ev_183_session_progress>,
+    RxEvent<SipPacket::Status::OK_200, ev_200_ok>,
+    RxEvent<SipPacket::Status::UNAUTHORIZED_401, ev_401_unauthorized>,
+    RxEvent<SipPacket::Status::PROXY_AUTH_REQ_407, ev_401_unauthorized>,
+    RxEvent<SipPacket::Status::BUSY_HERE_486, ev_486_busy_here>,
+    RxEvent<SipPacket::Status::REQUEST_CANCELLED_487, ev_487_request_cancelled>,
+    RxEvent<SipPacket::Status::SERVER_ERROR_500, ev_500_internal_server_error>,
+    RxEvent<SipPacket::Status::DECLINE_603, ev_603_decline>,
+    RxEvent<SipPacket::Status::UNKNOWN, ev_invite_failed>,
+    RxEvent<SipPacket::Method::NOTIFY, ev_rx_notify>,
+    RxEvent<SipPacket::Method::BYE, ev_rx_bye>,
+    RxEvent<SipPacket::Method::INFO, ev_rx_info>,
+    RxEvent<SipPacket::Method::INVITE, ev_rx_invite>>;
+
+/**
+ * Creates the event for a received packet, only events with data need a specialization
+ */
+template <typename EventT>
+EventT make_rx_event(const SipPacket& /*packet*/)
+{
+    return EventT {};
+}
+
+template <>
+inline ev_200_ok make_rx_event<ev_200_ok>(const SipPacket& packet)
+{
+    return ev_200_ok { packet.get_contact_expires() };
+}
+
+static constexpr size_t RX_STATUS_COUNT = static_cast<size_t>(SipPacket::Status::UNKNOWN) + 1;
+static constexpr size_t RX_METHOD_COUNT = static_cast<size_t>(SipPacket::Method::UNKNOWN) + 1;
+
+/**
+ * Index into the dispatch table, the responses come first, followed by the requests
+ */
+constexpr size_t rx_index(SipPacket::Status status)
+{
+    return static_cast<size_t>(status);
+}
+
+constexpr size_t rx_index(SipPacket::Method method)
+{
+    return RX_STATUS_COUNT + static_cast<size_t>(method);
+}
+
+inline size_t rx_index(const SipPacket& packet)
+{
+    return packet.is_response() ? rx_index(packet.get_status()) : rx_index(packet.get_method());
+}
+
+/**
+ * Jump table from rx_index() to the handler of the event, that is built at compile time from an RxEventList
+ *
+ * HandlerT provides on_rx_event(const SipPacket&, const EventT&) for all events of the list,
+ * packets without an entry (e.g. unknown status codes) are ignored.
+ */
+template <typename HandlerT, typename ListT = RxEvents>
+class RxDispatchTable;
+
+template <typename HandlerT, typename... RxEventsT>
+class RxDispatchTable<HandlerT, RxEventList<RxEventsT...>>
+{
+public:
+    static void dispatch(HandlerT& handler, const SipPacket& packet)
+    {
+        static_assert(has_unique_keys(), "Each status and method may only be bound to one event");
+        static constexpr TableT TABLE = make_table();
+        TABLE[rx_index(packet)](handler, packet);
+    }
+
+private:
+    using FunctionT = void (*)(HandlerT&, const SipPacket&);
+    using TableT = std::array<FunctionT, RX_STATUS_COUNT + RX_METHOD_COUNT>;
+
+    template <typename EventT>
+    static void emit(HandlerT& handler, const SipPacket& packet)
+    {
+        handler.on_rx_event(packet, make_rx_event<EventT>(packet));
+    }
+
+    static void ignore(HandlerT& /*handler*/, const SipPacket& /*packet*/)
+    {
+    }
+
+    static constexpr TableT make_table()
+    {
+        TableT table {};
+        for (FunctionT& function : table)
+        {
+            function = &ignore;
+        }
+        ((table[rx_index(RxEventsT::key)] = &emit<typename RxEventsT::event>), ...);
+        return table;
+    }
+
+    static constexpr bool has_unique_keys()
+    {
+        constexpr std::array<size_t, sizeof...(RxEventsT)> indices { rx_index(RxEventsT::key)... };
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            for (size_t j = i + 1; j < indices.size(); j++)
+            {
+                if (indices[i] == indices[j])
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
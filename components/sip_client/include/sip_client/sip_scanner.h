@@ -0,0 +1,190 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/**
+ * Bitmap of the positions of all structural characters of a SIP message
+ *
+ * The structural characters are \r : ; < > and ". The bitmap is built in one pass over the
+ * message, vectorized with AVX2, SSE2 or NEON if available (scalar e.g. on the ESP32).
+ * Afterwards the parser jumps from one structural character to the next one without
+ * looking at the bytes in between.
+ *
+ * Only the first CAPACITY bytes are indexed, searches beyond that fall back to memchr.
+ */
+template <size_t CAPACITY>
+class SipDelimiterIndex
+{
+    static_assert(CAPACITY % 64 == 0, "CAPACITY must be a multiple of 64");
+
+public:
+    static constexpr size_t npos = std::string_view::npos;
+
+    void build(const char* data, size_t length)
+    {
+        m_data = data;
+        m_length = length;
+        m_indexed_length = std::min(length, CAPACITY);
+
+        size_t pos = 0;
+#if defined(__AVX2__)
+        for (; pos + 32 <= m_indexed_length; pos += 32)
+        {
+            const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            __m256i match = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'));
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')));
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(';')));
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('<')));
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('>')));
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')));
+            store_mask(pos, static_cast<uint32_t>(_mm256_movemask_epi8(match)));
+        }
+#elif defined(__SSE2__)
+        for (; pos + 16 <= m_indexed_length; pos += 16)
+        {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            __m128i match = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'));
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')));
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(';')));
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('<')));
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('>')));
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')));
+            store_mask(pos, static_cast<uint32_t>(_mm_movemask_epi8(match)));
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        static const uint8_t bit_weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+        const uint8x16_t weights = vld1q_u8(bit_weights);
+        for (; pos + 16 <= m_indexed_length; pos += 16)
+        {
+            const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(data + pos));
+            uint8x16_t match = vceqq_u8(chunk, vdupq_n_u8('\r'));
+            match = vorrq_u8(match, vceqq_u8(chunk, vdupq_n_u8(':')));
+            match = vorrq_u8(match, vceqq_u8(chunk, vdupq_n_u8(';')));
+            match = vorrq_u8(match, vceqq_u8(chunk, vdupq_n_u8('<')));
+            match = vorrq_u8(match, vceqq_u8(chunk, vdupq_n_u8('>')));
+            match = vorrq_u8(match, vceqq_u8(chunk, vdupq_n_u8('"')));
+            // emulate movemask: keep one weighted bit per byte and add up each half
+            const uint8x16_t bits = vandq_u8(match, weights);
+            const uint32_t low = vaddv_u8(vget_low_u8(bits));
+            const uint32_t high = vaddv_u8(vget_high_u8(bits));
+            store_mask(pos, low | (high << 8));
+        }
+#endif
+        // scalar path for the remaining bytes and for targets without SIMD
+        uint64_t word = ((pos % 64) == 0) ? 0 : m_bitmap[pos / 64];
+        for (; pos < m_indexed_length; pos++)
+        {
+            if (is_delimiter(data[pos]))
+            {
+                word |= uint64_t { 1 } << (pos % 64);
+            }
+            if ((pos % 64) == 63)
+            {
+                m_bitmap[pos / 64] = word;
+                word = 0;
+            }
+        }
+        if ((pos % 64) != 0)
+        {
+            m_bitmap[pos / 64] = word;
+        }
+    }
+
+    /**
+     * Returns the position of the first delimiter c in [pos, end) or npos
+     *
+     * \param[in] c Must be one of the structural characters
+     */
+    [[nodiscard]] size_t find(char c, size_t pos, size_t end) const
+    {
+        end = std::min(end, m_length);
+        const size_t indexed_end = std::min(end, m_indexed_length);
+        while (pos < indexed_end)
+        {
+            uint64_t word = m_bitmap[pos / 64] & ~low_bits(pos % 64);
+            while (word != 0)
+            {
+                const size_t found = (pos & ~size_t { 63 }) + static_cast<size_t>(__builtin_ctzll(word));
+                if (found >= indexed_end)
+                {
+                    return npos;
+                }
+                if (m_data[found] == c)
+                {
+                    return found;
+                }
+                word &= word - 1;
+            }
+            pos = (pos & ~size_t { 63 }) + 64;
+        }
+        if (pos < end)
+        {
+            const auto* found = static_cast<const char*>(memchr(m_data + pos, c, end - pos));
+            return (found == nullptr) ? npos : static_cast<size_t>(found - m_data);
+        }
+        return npos;
+    }
+
+    /**
+     * Returns the position of the first c inside of the view or npos
+     *
+     * \param[in] view Must point into the indexed data
+     */
+    [[nodiscard]] size_t find(char c, std::string_view view) const
+    {
+        const auto start = static_cast<size_t>(view.data() - m_data);
+        const size_t found = find(c, start, start + view.size());
+        return (found == npos) ? npos : found - start;
+    }
+
+    static constexpr bool is_delimiter(char c)
+    {
+        return (c == '\r') || (c == ':') || (c == ';') || (c == '<') || (c == '>') || (c == '"');
+    }
+
+private:
+    static constexpr uint64_t low_bits(size_t count)
+    {
+        return (count == 0) ? 0 : (~uint64_t { 0 } >> (64 - count));
+    }
+
+    void store_mask(size_t pos, uint32_t mask)
+    {
+        const size_t shift = pos % 64;
+        uint64_t& word = m_bitmap[pos / 64];
+        word = (shift == 0) ? mask : (word | (static_cast<uint64_t>(mask) << shift));
+    }
+
+    const char* m_data {};
+    size_t m_length {};
+    size_t m_indexed_length {};
+    std::array<uint64_t, CAPACITY / 64> m_bitmap {};
+};
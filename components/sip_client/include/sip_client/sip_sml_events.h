@@ -16,6 +16,10 @@
 
 #pragma once
 
+class SipPacket;
+class SdpSession;
+struct SdpAudioStream;
+
 // event for sip sml state machine
 struct ev_start
 {
@@ -45,14 +49,33 @@ struct ev_cancel_call
 {
 };
 
+/**
+ * A received INVITE, the pointers are only valid while the event is processed
+ */
 struct ev_rx_invite
 {
+    const SipPacket* packet { nullptr };
+    /** The parsed sdp offer, nullptr if the INVITE has none */
+    const SdpSession* offer { nullptr };
+    /** The audio stream negotiated with the offer, only valid with an offer */
+    const SdpAudioStream* audio_stream { nullptr };
+    /** The sdp of the 200 OK */
+    std::string_view answer;
 };
 
 struct ev_rx_bye
 {
 };
 
+// received requests, that are handled without the state machine
+struct ev_rx_notify
+{
+};
+
+struct ev_rx_info
+{
+};
+
 struct ev_487_request_cancelled
 {
 };
@@ -65,6 +88,13 @@ struct ev_603_decline
 {
 };
 
+/**
+ * A final error response to the INVITE without an event of its own, e.g. 404, 480 or 503
+ */
+struct ev_invite_failed
+{
+};
+
 struct ev_500_internal_server_error
 {
 };
@@ -76,3 +106,10 @@ struct ev_reply_timeout
 struct ev_reregister
 {
 };
+
+/**
+ * No RTP was received for a while during a call, e.g. after its BYE was lost
+ */
+struct ev_media_timeout
+{
+};
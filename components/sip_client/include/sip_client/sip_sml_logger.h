@@ -18,8 +18,23 @@
 
 #include "boost/sml.hpp"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
 namespace sml = boost::sml;
 
+/**
+ * Loggers of the sip state machine, selected via the LoggerT template parameter of SipClient
+ *
+ * - Logger: prints every event, guard, action and state change as text
+ * - NoLogger: does nothing, all calls are optimized away
+ * - TraceLogger: records the last transitions in a ring buffer, that can be dumped e.g. after a failure
+ */
+
+/**
+ * Text logger, prints each step of the state machine with ESP_LOGI
+ */
 struct Logger
 {
     template <class SM, class TEvent>
@@ -51,3 +66,156 @@ struct Logger
 private:
     static constexpr const char* TAG = "SipSm";
 };
+
+/**
+ * Logger, that does nothing
+ */
+struct NoLogger
+{
+    template <class SM, class TEvent>
+    void log_process_event(const TEvent& /*unused*/)
+    {
+    }
+
+    template <class SM, class TGuard, class TEvent>
+    void log_guard(const TGuard& /*unused*/, const TEvent& /*unused*/, bool /*unused*/)
+    {
+    }
+
+    template <class SM, class TAction, class TEvent>
+    void log_action(const TAction& /*unused*/, const TEvent& /*unused*/)
+    {
+    }
+
+    template <class SM, class TSrcState, class TDstState>
+    void log_state_change(const TSrcState& /*unused*/, const TDstState& /*unused*/)
+    {
+    }
+};
+
+/**
+ * Binary trace of the last SIZE steps of the state machine
+ *
+ * Recording a step only stores the kind and pointers to functions, that return the type names,
+ * so there is no formatting and no heap allocation. The names are resolved by dump().
+ */
+template <size_t SIZE>
+class TraceLogger
+{
+public:
+    using NameT = const char* (*)();
+
+    enum class Kind : uint8_t
+    {
+        PROCESS_EVENT,
+        GUARD_OK,
+        GUARD_REJECT,
+        ACTION,
+        STATE_CHANGE,
+    };
+
+    /**
+     * One step, the event for PROCESS_EVENT, the guard or action and the event for
+     * GUARD_* and ACTION, the source and destination state for STATE_CHANGE
+     */
+    struct Record
+    {
+        Kind kind { Kind::PROCESS_EVENT };
+        NameT name { nullptr };
+        NameT detail { nullptr };
+    };
+
+    template <class SM, class TEvent>
+    void log_process_event(const TEvent& /*unused*/)
+    {
+        record(Kind::PROCESS_EVENT, &sml::aux::get_type_name<TEvent>, nullptr);
+    }
+
+    template <class SM, class TGuard, class TEvent>
+    void log_guard(const TGuard& /*unused*/, const TEvent& /*unused*/, bool result)
+    {
+        record(result ? Kind::GUARD_OK : Kind::GUARD_REJECT, &sml::aux::get_type_name<TGuard>, &sml::aux::get_type_name<TEvent>);
+    }
+
+    template <class SM, class TAction, class TEvent>
+    void log_action(const TAction& /*unused*/, const TEvent& /*unused*/)
+    {
+        record(Kind::ACTION, &sml::aux::get_type_name<TAction>, &sml::aux::get_type_name<TEvent>);
+    }
+
+    template <class SM, class TSrcState, class TDstState>
+    void log_state_change(const TSrcState& /*unused*/, const TDstState& /*unused*/)
+    {
+        record(Kind::STATE_CHANGE, &state_name<TSrcState>, &state_name<TDstState>);
+    }
+
+    /**
+     * Number of recorded steps, at most SIZE
+     */
+    [[nodiscard]] size_t size() const
+    {
+        return (m_count < SIZE) ? static_cast<size_t>(m_count) : SIZE;
+    }
+
+    /**
+     * Returns the recorded step, 0 is the oldest one
+     */
+    [[nodiscard]] const Record& at(size_t index) const
+    {
+        return m_records[(m_count - size() + index) % SIZE];
+    }
+
+    /**
+     * Prints the recorded steps, the oldest first
+     */
+    void dump() const
+    {
+        ESP_LOGI(TAG, "Last %u of %u steps:", static_cast<unsigned>(size()), static_cast<unsigned>(m_count));
+        for (size_t i = 0; i < size(); i++)
+        {
+            const Record& step = at(i);
+            switch (step.kind)
+            {
+            case Kind::PROCESS_EVENT:
+                ESP_LOGI(TAG, "[process_event] %s", step.name());
+                break;
+            case Kind::GUARD_OK:
+            case Kind::GUARD_REJECT:
+                ESP_LOGI(TAG, "[guard] %s %s %s", step.name(), step.detail(), (step.kind == Kind::GUARD_OK) ? "[OK]" : "[Reject]");
+                break;
+            case Kind::ACTION:
+                ESP_LOGI(TAG, "[action] %s %s", step.name(), step.detail());
+                break;
+            case Kind::STATE_CHANGE:
+                ESP_LOGI(TAG, "[transition] %s -> %s", step.name(), step.detail());
+                break;
+            }
+        }
+    }
+
+    void clear()
+    {
+        m_count = 0;
+    }
+
+private:
+    static_assert(SIZE > 0, "The trace needs at least one record");
+
+    template <class TState>
+    static const char* state_name()
+    {
+        return TState::c_str();
+    }
+
+    void record(Kind kind, NameT name, NameT detail)
+    {
+        m_records[m_count % SIZE] = Record { kind, name, detail };
+        m_count++;
+    }
+
+    std::array<Record, SIZE> m_records {};
+    /** Number of all recorded steps, also the overwritten ones */
+    uint32_t m_count { 0 };
+
+    static constexpr const char* TAG = "SipSm";
+};
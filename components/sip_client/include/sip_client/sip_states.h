@@ -78,11 +78,26 @@ struct sip_states
             sip.call_declined(event);
         };
 
+        const auto action_call_timed_out = [](SipClientT& sip, const auto& event) {
+            (void)event;
+            sip.call_timed_out();
+        };
+
         const auto action_rx_bye = [](SipClientT& sip, const auto& event) {
             (void)event;
             sip.handle_bye();
         };
 
+        const auto action_media_timeout = [](SipClientT& sip, const auto& event) {
+            (void)event;
+            sip.handle_media_timeout();
+        };
+
+        const auto action_leave_call = [](SipClientT& sip, const auto& event) {
+            (void)event;
+            sip.leave_call();
+        };
+
         const auto action_rx_internal_server_error = [](SipClientT& sip, const auto& event) {
             (void)event;
             sip.handle_internal_server_error();
@@ -107,14 +122,21 @@ struct sip_states
             "calling"_s + event<ev_487_request_cancelled> / action_call_cancelled = "registered"_s,
             "calling"_s + event<ev_486_busy_here> / action_call_declined = "registered"_s,
             "calling"_s + event<ev_603_decline> / action_call_declined = "registered"_s,
+            "calling"_s + event<ev_invite_failed> / action_call_declined = "registered"_s,
+            "calling"_s + event<ev_reply_timeout> / action_call_timed_out = "registered"_s,
             "calling"_s + event<ev_reregister> / action_retry_reregistered = "calling"_s,
             "calling"_s + event<ev_start> / action_register_unauth = "waiting_for_auth_reply"_s,
             "call_established"_s + event<ev_rx_bye> / action_rx_bye = "registered"_s,
+            "call_established"_s + event<ev_media_timeout> / action_media_timeout = "registered"_s,
+            "call_established"_s + sml::on_exit<_> / action_leave_call,
             "call_established"_s + event<ev_200_ok> = X,
-            "call_established"_s + event<ev_reregister> / action_retry_reregistered = "call_established"_s,
+            // internal transition, it does not leave the call
+            "call_established"_s + event<ev_reregister> / action_retry_reregistered,
             "call_established"_s + event<ev_start> / action_register_unauth = "waiting_for_auth_reply"_s,
             "cancelling"_s + event<ev_200_ok> = "cancelling"_s,
             "cancelling"_s + event<ev_487_request_cancelled> / action_call_cancelled = "registered"_s,
+            "cancelling"_s + event<ev_reply_timeout> / action_call_timed_out = "registered"_s,
+            "cancelling"_s + event<ev_invite_failed> / action_call_declined = "registered"_s,
             "calling"_s + event<ev_200_ok> = X);
     }
 };
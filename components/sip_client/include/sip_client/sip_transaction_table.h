@@ -0,0 +1,200 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * 64 bit FNV-1a hash over several parts, e.g. Call-ID, tag, branch and method
+ *
+ * The parts are separated, so that e.g. ("ab", "c") and ("a", "bc") differ.
+ */
+template <typename... Parts>
+uint64_t sip_key(const Parts&... parts)
+{
+    uint64_t result = 14695981039346656037ULL;
+    const auto add = [&result](std::string_view part) {
+        for (const char c : part)
+        {
+            result ^= static_cast<uint8_t>(c);
+            result *= 1099511628211ULL;
+        }
+        result ^= 0xFF;
+        result *= 1099511628211ULL;
+    };
+    (add(std::string_view(parts)), ...);
+    return result;
+}
+
+/**
+ * Hash table with fixed capacity and open addressing (linear probing)
+ *
+ * The keys are already hashes (see sip_key()), so they are used directly to select the slot.
+ * All entries are stored inline, so there are no heap allocations at all.
+ */
+template <typename ValueT, size_t CAPACITY>
+class FixedHashTable
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    /**
+     * Returns the value for the key or nullptr
+     */
+    ValueT* find(uint64_t key)
+    {
+        const size_t index = find_index(normalize(key));
+        return (index == NOT_FOUND) ? nullptr : &m_entries[index].value;
+    }
+
+    /**
+     * Inserts or replaces the value for the key
+     *
+     * \return false if the table is full
+     */
+    bool insert(uint64_t key, const ValueT& value)
+    {
+        ValueT* entry = insert(key);
+        if (entry == nullptr)
+        {
+            return false;
+        }
+        *entry = value;
+        return true;
+    }
+
+    /**
+     * Returns the value for the key to be filled in place, a new entry keeps the value of the previous one in the slot
+     *
+     * \return nullptr if the table is full
+     */
+    ValueT* insert(uint64_t key)
+    {
+        key = normalize(key);
+        size_t index = find_index(key);
+        if (index == NOT_FOUND)
+        {
+            index = find_free(key);
+            if (index == NOT_FOUND)
+            {
+                return nullptr;
+            }
+            m_entries[index].key = key;
+            m_size++;
+        }
+        return &m_entries[index].value;
+    }
+
+    bool erase(uint64_t key)
+    {
+        const size_t index = find_index(normalize(key));
+        if (index == NOT_FOUND)
+        {
+            return false;
+        }
+        m_entries[index].key = DELETED;
+        m_size--;
+        if (m_size == 0)
+        {
+            // drop the deleted markers, so that the probe sequences stay short
+            clear();
+        }
+        return true;
+    }
+
+    void clear()
+    {
+        for (auto& entry : m_entries)
+        {
+            entry.key = EMPTY;
+        }
+        m_size = 0;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * Calls func(key, value) for each entry, func may erase the visited entry
+     */
+    template <typename Func>
+    void for_each(Func&& func)
+    {
+        for (auto& entry : m_entries)
+        {
+            if ((entry.key != EMPTY) && (entry.key != DELETED))
+            {
+                func(entry.key, entry.value);
+            }
+        }
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t key { EMPTY };
+        ValueT value {};
+    };
+
+    /* Keys with a special meaning in the slots, real keys are moved out of the way */
+    static constexpr uint64_t EMPTY = 0;
+    static constexpr uint64_t DELETED = 1;
+    static constexpr size_t NOT_FOUND = CAPACITY;
+
+    static uint64_t normalize(uint64_t key)
+    {
+        return (key <= DELETED) ? key + 2 : key;
+    }
+
+    [[nodiscard]] size_t find_index(uint64_t key) const
+    {
+        for (size_t probe = 0; probe < CAPACITY; probe++)
+        {
+            const size_t index = (key + probe) & (CAPACITY - 1);
+            if (m_entries[index].key == key)
+            {
+                return index;
+            }
+            if (m_entries[index].key == EMPTY)
+            {
+                break;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    [[nodiscard]] size_t find_free(uint64_t key) const
+    {
+        for (size_t probe = 0; probe < CAPACITY; probe++)
+        {
+            const size_t index = (key + probe) & (CAPACITY - 1);
+            if ((m_entries[index].key == EMPTY) || (m_entries[index].key == DELETED))
+            {
+                return index;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    std::array<Entry, CAPACITY> m_entries {};
+    size_t m_size { 0 };
+};
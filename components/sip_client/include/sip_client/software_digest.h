@@ -0,0 +1,260 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "digest.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Portable digest backends without any library dependency
+ *
+ * They can be used instead of the mbedtls backends, e.g. on hosts without mbedtls.
+ */
+
+/**
+ * Buffering and padding of the hashes with 64 byte blocks (MD5, SHA-256)
+ *
+ * HashT provides transform(block) and IS_BIG_ENDIAN, the byte order of the length and the state words.
+ */
+template <typename HashT, size_t STATE_WORDS>
+class BlockDigest : public DigestBase<HashT>
+{
+public:
+    static constexpr size_t DIGEST_SIZE = 4 * STATE_WORDS;
+
+    using DigestBase<HashT>::update;
+
+    void update(const unsigned char* input, size_t length)
+    {
+        size_t used = static_cast<size_t>(m_length % BLOCK_SIZE);
+        m_length += length;
+        if (used > 0)
+        {
+            const size_t count = std::min(length, BLOCK_SIZE - used);
+            std::memcpy(m_block.data() + used, input, count);
+            input += count;
+            length -= count;
+            used += count;
+            if (used < BLOCK_SIZE)
+            {
+                return;
+            }
+            static_cast<HashT*>(this)->transform(m_block.data());
+        }
+        for (; length >= BLOCK_SIZE; length -= BLOCK_SIZE, input += BLOCK_SIZE)
+        {
+            static_cast<HashT*>(this)->transform(input);
+        }
+        std::memcpy(m_block.data(), input, length);
+    }
+
+    void finish(std::array<unsigned char, DIGEST_SIZE>& hash)
+    {
+        const uint64_t bits = m_length * 8;
+        std::array<unsigned char, BLOCK_SIZE + 8> padding {};
+        padding[0] = 0x80;
+        const size_t used = static_cast<size_t>(m_length % BLOCK_SIZE);
+        const size_t padding_length = (used < BLOCK_SIZE - 8) ? (BLOCK_SIZE - 8 - used) : (2 * BLOCK_SIZE - 8 - used);
+        std::array<unsigned char, 8> length_bytes {};
+        for (size_t i = 0; i < 8; i++)
+        {
+            const size_t shift = HashT::IS_BIG_ENDIAN ? (56 - 8 * i) : (8 * i);
+            length_bytes[i] = static_cast<unsigned char>(bits >> shift);
+        }
+        update(padding.data(), padding_length);
+        update(length_bytes.data(), length_bytes.size());
+
+        for (size_t i = 0; i < STATE_WORDS; i++)
+        {
+            for (size_t j = 0; j < 4; j++)
+            {
+                const size_t shift = HashT::IS_BIG_ENDIAN ? (24 - 8 * j) : (8 * j);
+                hash[4 * i + j] = static_cast<unsigned char>(m_state[i] >> shift);
+            }
+        }
+    }
+
+protected:
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    static uint32_t rotate_left(uint32_t value, unsigned bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    void reset(const std::array<uint32_t, STATE_WORDS>& initial_state)
+    {
+        m_state = initial_state;
+        m_length = 0;
+    }
+
+    std::array<uint32_t, STATE_WORDS> m_state {};
+
+private:
+    std::array<unsigned char, BLOCK_SIZE> m_block {};
+    uint64_t m_length { 0 };
+};
+
+/**
+ * MD5 (RFC 1321)
+ */
+class SoftwareMd5 : public BlockDigest<SoftwareMd5, 4>
+{
+public:
+    static constexpr DigestAlgorithm ALGORITHM = DigestAlgorithm::MD5;
+    static constexpr bool IS_BIG_ENDIAN = false;
+
+    void start()
+    {
+        reset({ 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 });
+    }
+
+    void transform(const unsigned char* block)
+    {
+        static constexpr std::array<uint32_t, 64> K {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+        };
+        static constexpr std::array<unsigned, 16> SHIFTS { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+        std::array<uint32_t, 16> words {};
+        for (size_t i = 0; i < words.size(); i++)
+        {
+            words[i] = static_cast<uint32_t>(block[4 * i]) | (static_cast<uint32_t>(block[4 * i + 1]) << 8)
+                | (static_cast<uint32_t>(block[4 * i + 2]) << 16) | (static_cast<uint32_t>(block[4 * i + 3]) << 24);
+        }
+
+        uint32_t a = m_state[0];
+        uint32_t b = m_state[1];
+        uint32_t c = m_state[2];
+        uint32_t d = m_state[3];
+        for (size_t i = 0; i < 64; i++)
+        {
+            uint32_t f = 0;
+            size_t g = 0;
+            switch (i / 16)
+            {
+            case 0:
+                f = (b & c) | (~b & d);
+                g = i;
+                break;
+            case 1:
+                f = (d & b) | (~d & c);
+                g = (5 * i + 1) % 16;
+                break;
+            case 2:
+                f = b ^ c ^ d;
+                g = (3 * i + 5) % 16;
+                break;
+            default:
+                f = c ^ (b | ~d);
+                g = (7 * i) % 16;
+                break;
+            }
+            f += a + K[i] + words[g];
+            a = d;
+            d = c;
+            c = b;
+            b += rotate_left(f, SHIFTS[(i / 16) * 4 + i % 4]);
+        }
+        m_state[0] += a;
+        m_state[1] += b;
+        m_state[2] += c;
+        m_state[3] += d;
+    }
+};
+
+/**
+ * SHA-256 (FIPS 180-4)
+ */
+class SoftwareSha256 : public BlockDigest<SoftwareSha256, 8>
+{
+public:
+    static constexpr DigestAlgorithm ALGORITHM = DigestAlgorithm::SHA_256;
+    static constexpr bool IS_BIG_ENDIAN = true;
+
+    void start()
+    {
+        reset({ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 });
+    }
+
+    void transform(const unsigned char* block)
+    {
+        static constexpr std::array<uint32_t, 64> K {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+        };
+
+        std::array<uint32_t, 64> words {};
+        for (size_t i = 0; i < 16; i++)
+        {
+            words[i] = (static_cast<uint32_t>(block[4 * i]) << 24) | (static_cast<uint32_t>(block[4 * i + 1]) << 16)
+                | (static_cast<uint32_t>(block[4 * i + 2]) << 8) | static_cast<uint32_t>(block[4 * i + 3]);
+        }
+        for (size_t i = 16; i < words.size(); i++)
+        {
+            const uint32_t s0 = rotate_right(words[i - 15], 7) ^ rotate_right(words[i - 15], 18) ^ (words[i - 15] >> 3);
+            const uint32_t s1 = rotate_right(words[i - 2], 17) ^ rotate_right(words[i - 2], 19) ^ (words[i - 2] >> 10);
+            words[i] = words[i - 16] + s0 + words[i - 7] + s1;
+        }
+
+        std::array<uint32_t, 8> v = m_state;
+        for (size_t i = 0; i < 64; i++)
+        {
+            const uint32_t s1 = rotate_right(v[4], 6) ^ rotate_right(v[4], 11) ^ rotate_right(v[4], 25);
+            const uint32_t choice = (v[4] & v[5]) ^ (~v[4] & v[6]);
+            const uint32_t temp1 = v[7] + s1 + choice + K[i] + words[i];
+            const uint32_t s0 = rotate_right(v[0], 2) ^ rotate_right(v[0], 13) ^ rotate_right(v[0], 22);
+            const uint32_t majority = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+            v[7] = v[6];
+            v[6] = v[5];
+            v[5] = v[4];
+            v[4] = v[3] + temp1;
+            v[3] = v[2];
+            v[2] = v[1];
+            v[1] = v[0];
+            v[0] = temp1 + s0 + majority;
+        }
+        for (size_t i = 0; i < m_state.size(); i++)
+        {
+            m_state[i] += v[i];
+        }
+    }
+
+private:
+    static uint32_t rotate_right(uint32_t value, unsigned bits)
+    {
+        return (value >> bits) | (value << (32 - bits));
+    }
+};
@@ -0,0 +1,385 @@
+/*
+   Copyright 2017 Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "asio.hpp"
+
+#include "inplace_function.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+/**
+ * Hierarchical timer wheel, that drives any number of timers with one asio::steady_timer
+ *
+ * The time is divided into ticks of TICK length. Level 0 has one slot per tick for the next
+ * SLOTS ticks, each higher level has one slot per SLOTS ticks of the level below. A timer is
+ * put into the slot of its expiry on the lowest level that reaches that far and moves down
+ * a level each time the wheel reaches the start of its slot (cascading).
+ *
+ * The timers are intrusive list nodes owned by the user (see Timer), so starting and
+ * cancelling a timer is O(1) and never allocates. The steady_timer is only armed for the
+ * next occupied slot, an idle wheel does not wake up.
+ *
+ * Timers fire up to one TICK late. There is one wheel per io_context (see acquire()),
+ * the callbacks run in the io_context.
+ */
+class TimerWheel : public std::enable_shared_from_this<TimerWheel>
+{
+public:
+    using ClockT = asio::steady_timer::clock_type;
+    using CallbackT = InplaceFunction<void()>;
+
+    static constexpr asio::chrono::milliseconds TICK { 10 };
+
+    /**
+     * One timer, that is started and cancelled via the wheel
+     *
+     * A pending timer is cancelled when it is destroyed. The callback is not called
+     * for cancelled timers.
+     */
+    class Timer
+    {
+    public:
+        Timer() = default;
+
+        ~Timer()
+        {
+            cancel();
+        }
+
+        Timer(const Timer&) = delete;
+        Timer(Timer&&) = delete;
+
+        Timer& operator=(const Timer&) = delete;
+        Timer& operator=(Timer&&) = delete;
+
+        void cancel()
+        {
+            if (m_wheel != nullptr)
+            {
+                m_wheel->cancel(*this);
+            }
+        }
+
+        [[nodiscard]] bool is_pending() const
+        {
+            return m_prev_next != nullptr;
+        }
+
+    private:
+        friend class TimerWheel;
+
+        TimerWheel* m_wheel { nullptr };
+        Timer* m_next { nullptr };
+        /** Points to the m_next of the previous timer or to the slot, nullptr if not pending */
+        Timer** m_prev_next { nullptr };
+        uint64_t m_expiry { 0 };
+        uint8_t m_level { 0 };
+        uint8_t m_slot { 0 };
+        CallbackT m_callback;
+    };
+
+    explicit TimerWheel(asio::io_context& io_context)
+        : m_io_context(io_context)
+        , m_timer(io_context)
+        , m_start(ClockT::now())
+    {
+    }
+
+    ~TimerWheel()
+    {
+        m_timer.cancel();
+        for (auto& level : m_slots)
+        {
+            for (Timer*& head : level)
+            {
+                while (head != nullptr)
+                {
+                    head->m_wheel = nullptr;
+                    unlink(*head);
+                }
+            }
+        }
+        registry().erase(&m_io_context);
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel(TimerWheel&&) = delete;
+
+    TimerWheel& operator=(const TimerWheel&) = delete;
+    TimerWheel& operator=(TimerWheel&&) = delete;
+
+    /**
+     * Returns the wheel of the io_context, it is created by the first user
+     */
+    static std::shared_ptr<TimerWheel> acquire(asio::io_context& io_context)
+    {
+        std::weak_ptr<TimerWheel>& entry = registry()[&io_context];
+        std::shared_ptr<TimerWheel> wheel = entry.lock();
+        if (!wheel)
+        {
+            wheel = std::make_shared<TimerWheel>(io_context);
+            entry = wheel;
+        }
+        return wheel;
+    }
+
+    /**
+     * Starts the timer, a pending timer is restarted
+     *
+     * \param[in] duration Time until the callback is called, rounded up to the next tick
+     */
+    void start(Timer& timer, ClockT::duration duration, CallbackT callback)
+    {
+        timer.cancel();
+        timer.m_wheel = this;
+        timer.m_callback = callback;
+        timer.m_expiry = to_tick(ClockT::now() + duration, true);
+        insert(timer, m_now + 1);
+        schedule();
+    }
+
+    void cancel(Timer& timer)
+    {
+        if (timer.is_pending())
+        {
+            // the steady_timer stays armed, an early wake up just finds nothing to do
+            unlink(timer);
+        }
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = 1U << SLOT_BITS;
+    /** 4 levels of 64 slots with 10 ms ticks reach about 46 hours, longer timers are cascaded again */
+    static constexpr size_t LEVELS = 4;
+    static constexpr uint64_t NO_TICK = UINT64_MAX;
+
+    static std::map<asio::io_context*, std::weak_ptr<TimerWheel>>& registry()
+    {
+        static std::map<asio::io_context*, std::weak_ptr<TimerWheel>> wheels;
+        return wheels;
+    }
+
+    /**
+     * Returns the tick of the time point, the first tick that is not before it if round_up is set
+     */
+    [[nodiscard]] uint64_t to_tick(ClockT::time_point time, bool round_up) const
+    {
+        if (time <= m_start)
+        {
+            return 0;
+        }
+        const auto tick = std::chrono::duration_cast<ClockT::duration>(TICK);
+        const auto elapsed = (time - m_start) + (round_up ? tick - ClockT::duration(1) : ClockT::duration(0));
+        return static_cast<uint64_t>(elapsed / tick);
+    }
+
+    [[nodiscard]] ClockT::time_point to_time(uint64_t tick) const
+    {
+        return m_start + std::chrono::duration_cast<ClockT::duration>(TICK) * tick;
+    }
+
+    /**
+     * Links the timer into the slot for its expiry, relative to the current tick
+     *
+     * \param[in] first_tick Expired timers are put into the slot of this tick
+     */
+    void insert(Timer& timer, uint64_t first_tick)
+    {
+        uint64_t expiry = std::max(timer.m_expiry, first_tick);
+        const uint64_t delta = expiry - m_now;
+        size_t level = 0;
+        while ((level < LEVELS - 1) && (delta >= (uint64_t { 1 } << (SLOT_BITS * (level + 1)))))
+        {
+            level++;
+        }
+        if (delta >= (uint64_t { 1 } << (SLOT_BITS * LEVELS)))
+        {
+            // too far in the future, park it in the last slot of the top level
+            expiry = m_now + (uint64_t { 1 } << (SLOT_BITS * LEVELS)) - 1;
+        }
+        const size_t slot = (expiry >> (SLOT_BITS * level)) & (SLOTS - 1);
+
+        Timer*& head = m_slots[level][slot];
+        timer.m_next = head;
+        if (head != nullptr)
+        {
+            head->m_prev_next = &timer.m_next;
+        }
+        timer.m_prev_next = &head;
+        head = &timer;
+        timer.m_level = static_cast<uint8_t>(level);
+        timer.m_slot = static_cast<uint8_t>(slot);
+        m_occupied[level] |= uint64_t { 1 } << slot;
+        m_size++;
+    }
+
+    /**
+     * Unlinks the timer from its slot or from a list returned by take_slot()
+     */
+    void unlink(Timer& timer)
+    {
+        *timer.m_prev_next = timer.m_next;
+        if (timer.m_next != nullptr)
+        {
+            timer.m_next->m_prev_next = timer.m_prev_next;
+        }
+        timer.m_next = nullptr;
+        timer.m_prev_next = nullptr;
+        if (m_slots[timer.m_level][timer.m_slot] == nullptr)
+        {
+            m_occupied[timer.m_level] &= ~(uint64_t { 1 } << timer.m_slot);
+        }
+        m_size--;
+    }
+
+    /**
+     * Moves all timers of a slot into a list, that is not part of the wheel
+     *
+     * The timers stay linked, so that callbacks can still cancel or restart them.
+     */
+    void take_slot(size_t level, size_t slot, Timer*& list)
+    {
+        list = m_slots[level][slot];
+        m_slots[level][slot] = nullptr;
+        m_occupied[level] &= ~(uint64_t { 1 } << slot);
+        if (list != nullptr)
+        {
+            list->m_prev_next = &list;
+        }
+    }
+
+    /**
+     * Returns the next tick after the current one, at which a slot has to be processed
+     */
+    [[nodiscard]] uint64_t next_tick() const
+    {
+        uint64_t result = NO_TICK;
+        for (size_t level = 0; level < LEVELS; level++)
+        {
+            const uint64_t bits = m_occupied[level];
+            if (bits == 0)
+            {
+                continue;
+            }
+            // rotate the bits, so that bit 0 is the slot after the current position
+            const uint64_t position = m_now >> (SLOT_BITS * level);
+            const size_t shift = (position + 1) & (SLOTS - 1);
+            const uint64_t rotated = (shift == 0) ? bits : ((bits >> shift) | (bits << (SLOTS - shift)));
+            const uint64_t offset = static_cast<uint64_t>(__builtin_ctzll(rotated)) + 1;
+            result = std::min(result, (position + offset) << (SLOT_BITS * level));
+        }
+        return result;
+    }
+
+    /**
+     * Processes all slots up to the tick, cascading the higher levels and calling the expired timers
+     */
+    void advance(uint64_t tick)
+    {
+        for (uint64_t next = next_tick(); next <= tick; next = next_tick())
+        {
+            m_now = next;
+            Timer* list = nullptr;
+            for (size_t level = LEVELS - 1; level > 0; level--)
+            {
+                if ((m_now & ((uint64_t { 1 } << (SLOT_BITS * level)) - 1)) != 0)
+                {
+                    continue;
+                }
+                take_slot(level, (m_now >> (SLOT_BITS * level)) & (SLOTS - 1), list);
+                while (list != nullptr)
+                {
+                    Timer& timer = *list;
+                    unlink(timer);
+                    // timers expiring right now go into the level 0 slot, that is processed below
+                    insert(timer, m_now);
+                }
+            }
+
+            take_slot(0, m_now & (SLOTS - 1), list);
+            while (list != nullptr)
+            {
+                Timer& timer = *list;
+                unlink(timer);
+                timer.m_callback();
+            }
+        }
+        m_now = std::max(m_now, tick);
+    }
+
+    /**
+     * Arms the steady_timer for the next occupied slot, unless it already fires earlier
+     */
+    void schedule()
+    {
+        if (m_advancing)
+        {
+            return;
+        }
+        const uint64_t next = next_tick();
+        if ((next == NO_TICK) || (next >= m_armed_tick))
+        {
+            return;
+        }
+        m_armed_tick = next;
+        m_timer.expires_at(to_time(next));
+        m_timer.async_wait([weak = weak_from_this()](const asio::error_code& ec) {
+            if (ec)
+            {
+                return;
+            }
+            if (const std::shared_ptr<TimerWheel> wheel = weak.lock())
+            {
+                wheel->on_timer();
+            }
+        });
+    }
+
+    void on_timer()
+    {
+        m_armed_tick = NO_TICK;
+        m_advancing = true;
+        advance(to_tick(ClockT::now(), false));
+        m_advancing = false;
+        schedule();
+    }
+
+    asio::io_context& m_io_context;
+    asio::steady_timer m_timer;
+    const ClockT::time_point m_start;
+    /** The last processed tick */
+    uint64_t m_now { 0 };
+    uint64_t m_armed_tick { NO_TICK };
+    bool m_advancing { false };
+    size_t m_size { 0 };
+
+    std::array<std::array<Timer*, SLOTS>, LEVELS> m_slots {};
+    /** One bit per occupied slot */
+    std::array<uint64_t, LEVELS> m_occupied {};
+};
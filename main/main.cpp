@@ -26,6 +26,7 @@
 
 #include "sip_client/asio_udp_client.h"
 #include "sip_client/mbedtls_md5.h"
+#include "sip_client/mbedtls_sha256.h"
 #include "sip_client/sip_client.h"
 #include "sip_client/sip_client_event_handler.h"
 
@@ -66,7 +67,15 @@ const int CONNECTED_BIT = BIT0;
 
 static const char* TAG = "main";
 
-using SipClientT = SipClient<AsioUdpClient, MbedtlsMd5>;
+#if CONFIG_SIP_SM_LOGGER_TRACE
+using SipSmLoggerT = TraceLogger<CONFIG_SIP_SM_TRACE_SIZE>;
+#elif CONFIG_SIP_SM_LOGGER_NONE
+using SipSmLoggerT = NoLogger;
+#else
+using SipSmLoggerT = Logger;
+#endif /* CONFIG_SIP_SM_LOGGER_TRACE */
+
+using SipClientT = SipClient<AsioUdpClient, MbedtlsMd5, MbedtlsSha256, SipSmLoggerT>;
 
 #ifdef ASIO_NO_EXCEPTIONS
 namespace asio::detail {
@@ -250,6 +259,12 @@ static void sip_task(void* pvParameters)
 
             client.set_event_handler([web_server](SipClientT& client, const SipClientEvent& event) {
                 std::apply([event, &client](auto&... h) { (h.handle(client, event), ...); }, handlers);
+#if CONFIG_SIP_SM_LOGGER_TRACE
+                if (event.event == SipClientEvent::Event::CALL_CANCELLED)
+                {
+                    client.get_sm_logger().dump();
+                }
+#endif /* CONFIG_SIP_SM_LOGGER_TRACE */
 #ifdef CONFIG_HTTP_SERVER
                 web_server->handle(client, event);
 #endif /* CONFIG_HTTP_SERVER */
@@ -0,0 +1,62 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Counts the heap allocations done via the global operator new
+ *
+ * The global operator new and delete are replaced in bench_main.cpp.
+ */
+struct AllocationStats
+{
+    static std::atomic<size_t> allocations;
+    static std::atomic<size_t> allocated_bytes;
+};
+
+/**
+ * Measures the allocations between construction and report()
+ * and adds them as per iteration counters to the benchmark state.
+ */
+class AllocationCounter
+{
+public:
+    AllocationCounter()
+        : m_allocations(AllocationStats::allocations.load(std::memory_order_relaxed))
+        , m_allocated_bytes(AllocationStats::allocated_bytes.load(std::memory_order_relaxed))
+    {
+    }
+
+    void report(benchmark::State& state, size_t bytes_per_op) const
+    {
+        const auto allocations = AllocationStats::allocations.load(std::memory_order_relaxed) - m_allocations;
+        const auto allocated_bytes = AllocationStats::allocated_bytes.load(std::memory_order_relaxed) - m_allocated_bytes;
+
+        state.counters["bytes/op"] = benchmark::Counter(static_cast<double>(bytes_per_op));
+        state.counters["allocs/op"] = benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+        state.counters["alloc_bytes/op"] = benchmark::Counter(static_cast<double>(allocated_bytes), benchmark::Counter::kAvgIterations);
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes_per_op));
+    }
+
+private:
+    const size_t m_allocations;
+    const size_t m_allocated_bytes;
+};
@@ -0,0 +1,49 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "allocation_counter.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <new>
+
+std::atomic<size_t> AllocationStats::allocations { 0 };
+std::atomic<size_t> AllocationStats::allocated_bytes { 0 };
+
+void* operator new(std::size_t size)
+{
+    AllocationStats::allocations.fetch_add(1, std::memory_order_relaxed);
+    AllocationStats::allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t /*unused*/) noexcept
+{
+    std::free(ptr);
+}
+
+BENCHMARK_MAIN();
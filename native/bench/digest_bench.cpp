@@ -0,0 +1,63 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "allocation_counter.h"
+
+#include "sip_client/mbedtls_md5.h"
+#include "sip_client/mbedtls_sha256.h"
+#include "sip_client/software_digest.h"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <string_view>
+
+/**
+ * Computing a response of the digest authentication with qop=auth (HA1, HA2 and the response)
+ *
+ * The three hashes are about the size of the ones the sip client computes for a REGISTER.
+ */
+template <typename DigestT>
+static void BM_DigestResponse(benchmark::State& state)
+{
+    DigestT digest;
+    std::array<unsigned char, DigestT::DIGEST_SIZE> hash {};
+
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        digest.start();
+        digest.update("620", ":", "fritz.box", ":", "secret");
+        digest.finish(hash);
+        const std::array<char, 2 * DigestT::DIGEST_SIZE> ha1 = to_hex(hash);
+
+        digest.start();
+        digest.update("REGISTER", ":", "sip:192.168.179.1");
+        digest.finish(hash);
+        const std::array<char, 2 * DigestT::DIGEST_SIZE> ha2 = to_hex(hash);
+
+        digest.start();
+        digest.update(std::string_view(ha1.data(), ha1.size()), ":", "4A9D3E1B2C7F", ":", "00000001", ":", "269ca6d7", ":auth:", std::string_view(ha2.data(), ha2.size()));
+        digest.finish(hash);
+        benchmark::DoNotOptimize(hash);
+    }
+    allocation_counter.report(state, 0);
+    state.counters["bytes/backend"] = benchmark::Counter(static_cast<double>(sizeof(DigestT)));
+}
+BENCHMARK_TEMPLATE(BM_DigestResponse, MbedtlsMd5);
+BENCHMARK_TEMPLATE(BM_DigestResponse, SoftwareMd5);
+BENCHMARK_TEMPLATE(BM_DigestResponse, MbedtlsSha256);
+BENCHMARK_TEMPLATE(BM_DigestResponse, SoftwareSha256);
@@ -0,0 +1,25 @@
+#pragma once
+
+/* Replaces native/esp_log.h in the benchmarks, so that the measurements
+ * do not include formatting and printing of log messages.
+ * The arguments are still referenced (no unused variable warnings), but never evaluated.
+ */
+
+static inline void bench_log_discard(const char* /*prefix*/, const char* /*fmt*/, ...)
+{
+}
+
+#define BENCH_LOG_DISCARD(prefix, fmt, ...)                \
+    do                                                     \
+    {                                                      \
+        if (false)                                         \
+        {                                                  \
+            bench_log_discard(prefix, fmt, ##__VA_ARGS__); \
+        }                                                  \
+    } while (false)
+
+#define ESP_LOGE(prefix, fmt, ...) BENCH_LOG_DISCARD(prefix, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(prefix, fmt, ...) BENCH_LOG_DISCARD(prefix, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(prefix, fmt, ...) BENCH_LOG_DISCARD(prefix, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(prefix, fmt, ...) BENCH_LOG_DISCARD(prefix, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(prefix, fmt, ...) BENCH_LOG_DISCARD(prefix, fmt, ##__VA_ARGS__)
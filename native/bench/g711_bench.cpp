@@ -0,0 +1,125 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "allocation_counter.h"
+
+#include "sip_client/g711.h"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+/** One 20 ms frame at 8 kHz */
+constexpr size_t FRAME_SAMPLES = 160;
+
+/**
+ * A 440 Hz tone, so that all segments are used
+ */
+std::array<int16_t, FRAME_SAMPLES> make_tone()
+{
+    std::array<int16_t, FRAME_SAMPLES> samples {};
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        samples[i] = static_cast<int16_t>(30000.0 * std::sin(2.0 * M_PI * 440.0 * static_cast<double>(i) / 8000.0));
+    }
+    return samples;
+}
+
+template <typename CodecT>
+std::array<uint8_t, FRAME_SAMPLES> make_codes()
+{
+    const std::array<int16_t, FRAME_SAMPLES> samples = make_tone();
+    std::array<uint8_t, FRAME_SAMPLES> codes {};
+    CodecT::encode(samples.data(), samples.size(), codes.data());
+    return codes;
+}
+}
+
+/**
+ * Encoding a 20 ms frame, sample by sample (the table driven scalar code) or as a frame (vectorized, if available)
+ */
+template <typename CodecT, bool FRAME>
+static void BM_G711Encode(benchmark::State& state)
+{
+    std::array<int16_t, FRAME_SAMPLES> samples = make_tone();
+    std::array<uint8_t, FRAME_SAMPLES> codes {};
+
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        // the arrays escape, so that each iteration reads and writes all of them
+        benchmark::DoNotOptimize(samples.data());
+        benchmark::DoNotOptimize(codes.data());
+        if constexpr (FRAME)
+        {
+            CodecT::encode(samples.data(), samples.size(), codes.data());
+        }
+        else
+        {
+            for (size_t i = 0; i < samples.size(); i++)
+            {
+                codes[i] = CodecT::encode(samples[i]);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    allocation_counter.report(state, sizeof(samples));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * FRAME_SAMPLES));
+}
+BENCHMARK_TEMPLATE(BM_G711Encode, PcmuCodec, false);
+BENCHMARK_TEMPLATE(BM_G711Encode, PcmuCodec, true);
+BENCHMARK_TEMPLATE(BM_G711Encode, PcmaCodec, false);
+BENCHMARK_TEMPLATE(BM_G711Encode, PcmaCodec, true);
+
+/**
+ * Decoding a 20 ms frame, sample by sample (table lookups) or as a frame (vectorized, if available)
+ */
+template <typename CodecT, bool FRAME>
+static void BM_G711Decode(benchmark::State& state)
+{
+    std::array<uint8_t, FRAME_SAMPLES> codes = make_codes<CodecT>();
+    std::array<int16_t, FRAME_SAMPLES> samples {};
+
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        // the arrays escape, so that each iteration reads and writes all of them
+        benchmark::DoNotOptimize(codes.data());
+        benchmark::DoNotOptimize(samples.data());
+        if constexpr (FRAME)
+        {
+            CodecT::decode(codes.data(), codes.size(), samples.data());
+        }
+        else
+        {
+            for (size_t i = 0; i < codes.size(); i++)
+            {
+                samples[i] = CodecT::decode(codes[i]);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    allocation_counter.report(state, sizeof(codes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * FRAME_SAMPLES));
+}
+BENCHMARK_TEMPLATE(BM_G711Decode, PcmuCodec, false);
+BENCHMARK_TEMPLATE(BM_G711Decode, PcmuCodec, true);
+BENCHMARK_TEMPLATE(BM_G711Decode, PcmaCodec, false);
+BENCHMARK_TEMPLATE(BM_G711Decode, PcmaCodec, true);
@@ -0,0 +1,129 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "allocation_counter.h"
+#include "sip_corpus.h"
+
+#include "deferred_log.h"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+
+/**
+ * Cost for the caller of logging a received packet, as AsioUdpClient does with ESP_LOGV
+ *
+ * The output goes to /dev/null, so only the formatting is measured, not the terminal.
+ */
+static void BM_LogPrintf(benchmark::State& state)
+{
+    FILE* output = std::fopen("/dev/null", "w");
+    const std::string_view packet = sip_corpus::INVITE;
+
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        std::fprintf(output, "[%s] [%s] ", "VER", "AsioUdpClient");
+        std::fprintf(output, "Received following data: %.*s", static_cast<int>(packet.size()), packet.data());
+        std::fputc('\n', output);
+    }
+    allocation_counter.report(state, 0);
+    std::fclose(output);
+}
+BENCHMARK(BM_LogPrintf);
+
+/**
+ * The same with DeferredLog, the formatting is done by its background thread
+ *
+ * The timing is paused while waiting for the background thread, so that no record is dropped.
+ */
+static void BM_LogDeferred(benchmark::State& state)
+{
+    FILE* output = std::fopen("/dev/null", "w");
+    const std::string_view packet = sip_corpus::INVITE;
+    size_t count = 0;
+    {
+        DeferredLog log(output);
+        const AllocationCounter allocation_counter;
+        for (auto _ : state)
+        {
+            log.log("VER", "AsioUdpClient", "Received following data: %.*s", static_cast<int>(packet.size()), packet.data());
+            if (++count % (DeferredLog::CAPACITY / 2) == 0)
+            {
+                state.PauseTiming();
+                log.flush();
+                state.ResumeTiming();
+            }
+        }
+        allocation_counter.report(state, 0);
+        state.counters["dropped"] = benchmark::Counter(static_cast<double>(log.dropped()));
+    }
+    std::fclose(output);
+}
+BENCHMARK(BM_LogDeferred);
+
+/**
+ * Logging the button press of SipClientEventHandler, a char and an uint16_t duration
+ *
+ * Before the timing starts, the deferred output is compared with the one of printf, so that
+ * e.g. a stored number is not printed as something else.
+ */
+static void BM_LogDeferredNumbers(benchmark::State& state)
+{
+    constexpr const char* FORMAT = "Button '%c' for %d milliseconds, %s";
+    const uint16_t duration = 250;
+
+    std::array<char, 128> expected {};
+    std::snprintf(expected.data(), expected.size(), "[%s] [%s] %s\n", "INFO", "EventHandler", "Button '5' for 250 milliseconds, done");
+    std::array<char, 128> printed {};
+    FILE* check = std::tmpfile();
+    {
+        DeferredLog log(check);
+        log.log("INFO", "EventHandler", FORMAT, '5', duration, "done");
+        log.flush();
+    }
+    std::rewind(check);
+    const size_t size = std::fread(printed.data(), 1, printed.size() - 1, check);
+    std::fclose(check);
+    if (std::string_view(printed.data(), size) != std::string_view(expected.data()))
+    {
+        state.SkipWithError("Deferred output differs from printf");
+        return;
+    }
+
+    FILE* output = std::fopen("/dev/null", "w");
+    size_t count = 0;
+    {
+        DeferredLog log(output);
+        const AllocationCounter allocation_counter;
+        for (auto _ : state)
+        {
+            log.log("INFO", "EventHandler", FORMAT, '5', duration, "done");
+            if (++count % (DeferredLog::CAPACITY / 2) == 0)
+            {
+                state.PauseTiming();
+                log.flush();
+                state.ResumeTiming();
+            }
+        }
+        allocation_counter.report(state, 0);
+    }
+    std::fclose(output);
+}
+BENCHMARK(BM_LogDeferredNumbers);
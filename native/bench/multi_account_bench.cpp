@@ -0,0 +1,111 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "asio.hpp"
+
+#include "allocation_counter.h"
+#include "null_udp_client.h"
+
+#include "sip_client/mbedtls_md5.h"
+#include "sip_client/sip_account_manager.h"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <string>
+
+using BenchAccountManager = SipAccountManager<NullUdpClient, MbedtlsMd5>;
+
+static constexpr uint16_t SIP_LOCAL_PORT = 5060;
+static constexpr unsigned FIRST_USER = 1000;
+
+static void add_accounts(BenchAccountManager& manager, int64_t count)
+{
+    for (int64_t i = 0; i < count; i++)
+    {
+        manager.add_account(std::to_string(FIRST_USER + i), "secret");
+    }
+}
+
+/**
+ * Heap and object memory per account, i.e. how the memory grows with the number of accounts
+ *
+ * All accounts are created and registered (the REGISTER is sent, no reply),
+ * which includes the routing entries of the shared socket.
+ */
+static void BM_MultiAccountMemory(benchmark::State& state)
+{
+    const int64_t accounts = state.range(0);
+    size_t bytes_per_account = 0;
+    for (auto _ : state)
+    {
+        asio::io_context io_context;
+        const size_t allocated_before = AllocationStats::allocated_bytes.load(std::memory_order_relaxed);
+        {
+            BenchAccountManager manager { io_context, "192.168.179.1", "5060", "192.168.170.30", std::chrono::milliseconds(0) };
+            add_accounts(manager, accounts);
+            manager.init();
+            io_context.poll();
+
+            const size_t allocated = AllocationStats::allocated_bytes.load(std::memory_order_relaxed) - allocated_before;
+            bytes_per_account = allocated / static_cast<size_t>(accounts);
+            state.PauseTiming();
+        }
+        state.ResumeTiming();
+    }
+    state.counters["accounts"] = benchmark::Counter(static_cast<double>(accounts));
+    state.counters["bytes/account"] = benchmark::Counter(static_cast<double>(bytes_per_account));
+    state.counters["sizeof(SipClient)"] = benchmark::Counter(static_cast<double>(sizeof(BenchAccountManager::SipClientT)));
+}
+BENCHMARK(BM_MultiAccountMemory)->RangeMultiplier(10)->Range(1, 1000)->Unit(benchmark::kMillisecond);
+
+/**
+ * Routing of a received request to one of many registered accounts
+ */
+static void BM_MultiAccountRoute(benchmark::State& state)
+{
+    const int64_t accounts = state.range(0);
+    asio::io_context io_context;
+    BenchAccountManager manager { io_context, "192.168.179.1", "5060", "192.168.170.30", std::chrono::milliseconds(0) };
+    add_accounts(manager, accounts);
+    manager.init();
+    io_context.poll();
+
+    const std::string user = std::to_string(FIRST_USER + accounts - 1);
+    const std::string notify = "NOTIFY sip:" + user + "@192.168.170.30:5060;transport=udp SIP/2.0\r\n"
+                                                      "Via: SIP/2.0/UDP 192.168.179.1:5060;branch=z9hG4bK5A6B7C8D9E0F1A2B\r\n"
+                                                      "From: <sip:"
+        + user + "@fritz.box>;tag=B2C3D4E5F6071829\r\n"
+                 "To: <sip:"
+        + user + "@fritz.box>;tag=846930886\r\n"
+                 "Call-ID: 7D8E9F0A1B2C3D4E@192.168.179.1\r\n"
+                 "CSeq: 2 NOTIFY\r\n"
+                 "Event: message-summary\r\n"
+                 "Content-Type: application/simple-message-summary\r\n"
+                 "Content-Length: 23\r\n"
+                 "\r\n"
+                 "Messages-Waiting: no\r\n";
+
+    NullUdpClient& socket = NullUdpClient::instance(SIP_LOCAL_PORT);
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        socket.inject(notify);
+    }
+    allocation_counter.report(state, socket.sent_bytes());
+    state.counters["accounts"] = benchmark::Counter(static_cast<double>(accounts));
+}
+BENCHMARK(BM_MultiAccountRoute)->RangeMultiplier(10)->Range(1, 1000);
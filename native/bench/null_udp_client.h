@@ -0,0 +1,131 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "asio.hpp"
+
+#include "sip_client/asio_udp_client.h"
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <string>
+
+/**
+ * Drop-in replacement for AsioUdpClient without a socket
+ *
+ * Sent messages are only counted, received messages are injected by the benchmark.
+ * The sockets are created inside of the sip client, so the benchmark finds them
+ * by their local port.
+ */
+class NullUdpClient
+{
+public:
+    NullUdpClient(asio::io_context& /*io_context*/, const std::string& /*server_ip*/, const std::string& /*server_port*/, uint16_t local_port, RxCallbackT on_received)
+        : m_local_port(local_port)
+        , m_on_received { on_received }
+    {
+        instances()[m_local_port] = this;
+    }
+
+    ~NullUdpClient()
+    {
+        instances().erase(m_local_port);
+    }
+
+    NullUdpClient(const NullUdpClient&) = delete;
+    NullUdpClient& operator=(const NullUdpClient&) = delete;
+
+    static NullUdpClient& instance(uint16_t local_port)
+    {
+        return *instances().at(local_port);
+    }
+
+    bool init()
+    {
+        m_initialized = true;
+        return true;
+    }
+
+    void deinit()
+    {
+        m_initialized = false;
+    }
+
+    [[nodiscard]] bool is_initialized() const
+    {
+        return m_initialized;
+    }
+
+    void set_server_ip(const std::string& /*server_ip*/)
+    {
+    }
+
+    bool set_destination(std::string_view /*ip*/, uint16_t /*port*/)
+    {
+        return true;
+    }
+
+    TxBufferT& get_new_tx_buf()
+    {
+        m_tx_buffer.clear();
+        return m_tx_buffer;
+    }
+
+    void set_tx_backlog_limit(size_t /*limit*/)
+    {
+    }
+
+    template <typename... Fragments>
+    bool send_buffered_data(const Fragments&... body)
+    {
+        m_sent_bytes = m_tx_buffer.size() + (asio::buffer_size(asio::const_buffer(body)) + ... + 0);
+        benchmark::DoNotOptimize(m_tx_buffer.data());
+        return true;
+    }
+
+    void inject(std::string_view data)
+    {
+        m_on_received(data);
+    }
+
+    /**
+     * Header part (without body fragments) of the last sent message
+     */
+    [[nodiscard]] std::string_view last_sent() const
+    {
+        return { m_tx_buffer.data(), m_tx_buffer.size() };
+    }
+
+    [[nodiscard]] size_t sent_bytes() const
+    {
+        return m_sent_bytes;
+    }
+
+private:
+    static std::map<uint16_t, NullUdpClient*>& instances()
+    {
+        static std::map<uint16_t, NullUdpClient*> sockets;
+        return sockets;
+    }
+
+    const uint16_t m_local_port;
+    RxCallbackT m_on_received;
+    TxBufferT m_tx_buffer;
+    size_t m_sent_bytes { 0 };
+    bool m_initialized { false };
+};
@@ -0,0 +1,76 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "allocation_counter.h"
+
+#include "sip_client/rtp_receiver.h"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace
+{
+constexpr size_t FRAME_SIZE = 160;
+constexpr size_t HEADER_SIZE = 12;
+
+/**
+ * A 20 ms PCMU packet, as sent by the PBX
+ */
+std::array<char, HEADER_SIZE + FRAME_SIZE> make_rtp_packet(uint16_t sequence_number, uint32_t timestamp)
+{
+    std::array<char, HEADER_SIZE + FRAME_SIZE> packet {};
+    packet[0] = static_cast<char>(0x80);
+    packet[1] = 0;
+    packet[2] = static_cast<char>(sequence_number >> 8);
+    packet[3] = static_cast<char>(sequence_number);
+    for (size_t i = 0; i < 4; i++)
+    {
+        packet[4 + i] = static_cast<char>(timestamp >> (24 - 8 * i));
+        packet[8 + i] = static_cast<char>(0x5EADBEEF >> (24 - 8 * i));
+    }
+    for (size_t i = HEADER_SIZE; i < packet.size(); i++)
+    {
+        packet[i] = static_cast<char>(0xFF);
+    }
+    return packet;
+}
+}
+
+/**
+ * Receiving one 20 ms frame into the jitter buffer and playing it out, arg 1 swaps each pair of packets
+ */
+static void BM_RtpReceive(benchmark::State& state)
+{
+    const bool reorder = state.range(0) != 0;
+    RtpReceiver<> receiver;
+    uint16_t sequence_number = 0;
+
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        const uint16_t sent = reorder ? (sequence_number ^ 1U) : sequence_number;
+        const auto packet = make_rtp_packet(sent, sent * FRAME_SIZE);
+        receiver.rx(std::string_view(packet.data(), packet.size()), sequence_number * FRAME_SIZE);
+        benchmark::DoNotOptimize(receiver.current()->pop());
+        sequence_number++;
+    }
+    allocation_counter.report(state, HEADER_SIZE + FRAME_SIZE);
+    state.counters["bytes/receiver"] = benchmark::Counter(static_cast<double>(sizeof(RtpReceiver<>)));
+}
+BENCHMARK(BM_RtpReceive)->Arg(0)->Arg(1);
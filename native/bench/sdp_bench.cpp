@@ -0,0 +1,73 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "asio.hpp"
+
+#include "allocation_counter.h"
+
+#include "sip_client/asio_udp_client.h"
+#include "sip_client/sdp.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string_view>
+
+namespace
+{
+/**
+ * Offer of an INVITE from a softphone with video, the audio section is accepted with PCMA, PCMU and telephone-event
+ */
+constexpr std::string_view OFFER = "v=0\r\n"
+                                   "o=- 3912345678 3912345678 IN IP4 192.168.179.20\r\n"
+                                   "s=softphone\r\n"
+                                   "c=IN IP4 192.168.179.20\r\n"
+                                   "t=0 0\r\n"
+                                   "m=audio 40000 RTP/AVP 9 8 0 18 96\r\n"
+                                   "a=rtpmap:9 G722/8000\r\n"
+                                   "a=rtpmap:8 PCMA/8000\r\n"
+                                   "a=rtpmap:0 PCMU/8000\r\n"
+                                   "a=rtpmap:18 G729/8000\r\n"
+                                   "a=fmtp:18 annexb=no\r\n"
+                                   "a=rtpmap:96 telephone-event/8000\r\n"
+                                   "a=fmtp:96 0-16\r\n"
+                                   "a=ptime:20\r\n"
+                                   "a=sendrecv\r\n"
+                                   "m=video 40002 RTP/AVP 97\r\n"
+                                   "a=rtpmap:97 H264/90000\r\n"
+                                   "a=fmtp:97 profile-level-id=42e01f\r\n";
+}
+
+/**
+ * Parsing an offer, selecting the codecs and writing the media sections of the answer
+ */
+static void BM_SdpAnswer(benchmark::State& state)
+{
+    Buffer<640> answer;
+
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        SdpSession offer;
+        SdpAudioStream stream;
+        offer.parse(OFFER);
+        SdpAudioStream::negotiate(offer, true, stream);
+        answer.clear();
+        stream.write_answer(offer, 7078, answer);
+        benchmark::DoNotOptimize(answer.data());
+    }
+    allocation_counter.report(state, OFFER.size());
+}
+BENCHMARK(BM_SdpAnswer);
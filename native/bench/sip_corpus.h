@@ -0,0 +1,154 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/**
+ * SIP messages as received from a FRITZ!Box, used as benchmark input
+ */
+namespace sip_corpus {
+
+constexpr std::string_view REGISTER_401 = "SIP/2.0 401 Unauthorized\r\n"
+                                          "Via: SIP/2.0/UDP 192.168.170.30:5060;branch=z9hG4bK-1804289383;rport=5060\r\n"
+                                          "From: <sip:620@192.168.179.1>;tag=846930886\r\n"
+                                          "To: <sip:620@192.168.179.1>;tag=9E0B0F3DD8A5D0D5\r\n"
+                                          "Call-ID: 1681692777@192.168.170.30\r\n"
+                                          "CSeq: 1714636915 REGISTER\r\n"
+                                          "WWW-Authenticate: Digest realm=\"fritz.box\", nonce=\"3F1E6E3B2C9D7A44\"\r\n"
+                                          "User-Agent: FRITZ!OS\r\n"
+                                          "Content-Length: 0\r\n"
+                                          "\r\n";
+
+constexpr std::string_view REGISTER_200 = "SIP/2.0 200 OK\r\n"
+                                          "Via: SIP/2.0/UDP 192.168.170.30:5060;branch=z9hG4bK-1957747793;rport=5060\r\n"
+                                          "From: <sip:620@192.168.179.1>;tag=424238335\r\n"
+                                          "To: <sip:620@192.168.179.1>;tag=F2B6B3A1E5C0D4A2\r\n"
+                                          "Call-ID: 1681692777@192.168.170.30\r\n"
+                                          "CSeq: 1714636916 REGISTER\r\n"
+                                          "Contact: <sip:620@192.168.170.30:5060;transport=udp>;expires=300\r\n"
+                                          "User-Agent: FRITZ!OS\r\n"
+                                          "Content-Length: 0\r\n"
+                                          "\r\n";
+
+constexpr std::string_view INVITE = "INVITE sip:620@192.168.170.30:5060;transport=udp SIP/2.0\r\n"
+                                    "Via: SIP/2.0/UDP 192.168.179.1:5060;branch=z9hG4bK6B7C3D1E9A2F4B5C\r\n"
+                                    "Record-Route: <sip:192.168.179.1;lr>\r\n"
+                                    "From: \"Phone\" <sip:**611@fritz.box>;tag=A1B2C3D4E5F60718\r\n"
+                                    "To: <sip:620@fritz.box>\r\n"
+                                    "Call-ID: 8C2E4A6B1D3F5A7C@192.168.179.1\r\n"
+                                    "CSeq: 102 INVITE\r\n"
+                                    "Contact: <sip:**611@192.168.179.1;uniq=34A12B56C78D9E0F>\r\n"
+                                    "P-Called-Party-ID: <sip:620@fritz.box>\r\n"
+                                    "Allow: INVITE, ACK, OPTIONS, CANCEL, BYE, UPDATE, PRACK, INFO, SUBSCRIBE, NOTIFY, REFER, MESSAGE, PUBLISH\r\n"
+                                    "Supported: 100rel, replaces, timer\r\n"
+                                    "User-Agent: FRITZ!OS\r\n"
+                                    "Content-Type: application/sdp\r\n"
+                                    "Content-Length: 241\r\n"
+                                    "\r\n"
+                                    "v=0\r\n"
+                                    "o=user 12345678 12345678 IN IP4 192.168.179.1\r\n"
+                                    "s=call\r\n"
+                                    "c=IN IP4 192.168.179.1\r\n"
+                                    "t=0 0\r\n"
+                                    "m=audio 7078 RTP/AVP 8 0 101\r\n"
+                                    "a=rtpmap:8 PCMA/8000\r\n"
+                                    "a=rtpmap:0 PCMU/8000\r\n"
+                                    "a=rtpmap:101 telephone-event/8000\r\n"
+                                    "a=fmtp:101 0-15\r\n"
+                                    "a=sendrecv\r\n"
+                                    "a=ptime:20\r\n";
+
+constexpr std::string_view INFO_DTMF = "INFO sip:620@192.168.170.30:5060;transport=udp SIP/2.0\r\n"
+                                       "Via: SIP/2.0/UDP 192.168.179.1:5060;branch=z9hG4bK0F1E2D3C4B5A6978\r\n"
+                                       "From: \"Phone\" <sip:**611@fritz.box>;tag=A1B2C3D4E5F60718\r\n"
+                                       "To: <sip:620@fritz.box>;tag=1804289383\r\n"
+                                       "Call-ID: 8C2E4A6B1D3F5A7C@192.168.179.1\r\n"
+                                       "CSeq: 103 INFO\r\n"
+                                       "Contact: <sip:**611@192.168.179.1;uniq=34A12B56C78D9E0F>\r\n"
+                                       "User-Agent: FRITZ!OS\r\n"
+                                       "Content-Type: application/dtmf-relay\r\n"
+                                       "Content-Length: 24\r\n"
+                                       "\r\n"
+                                       "Signal=5\r\n"
+                                       "Duration=160\r\n";
+
+constexpr std::string_view NOTIFY = "NOTIFY sip:620@192.168.170.30:5060;transport=udp SIP/2.0\r\n"
+                                    "Via: SIP/2.0/UDP 192.168.179.1:5060;branch=z9hG4bK5A6B7C8D9E0F1A2B\r\n"
+                                    "From: <sip:620@fritz.box>;tag=B2C3D4E5F6071829\r\n"
+                                    "To: <sip:620@fritz.box>;tag=846930886\r\n"
+                                    "Call-ID: 7D8E9F0A1B2C3D4E@192.168.179.1\r\n"
+                                    "CSeq: 2 NOTIFY\r\n"
+                                    "Event: message-summary\r\n"
+                                    "Subscription-State: active;expires=3600\r\n"
+                                    "User-Agent: FRITZ!OS\r\n"
+                                    "Content-Type: application/simple-message-summary\r\n"
+                                    "Content-Length: 23\r\n"
+                                    "\r\n"
+                                    "Messages-Waiting: no\r\n";
+
+constexpr std::string_view BYE = "BYE sip:620@192.168.170.30:5060;transport=udp SIP/2.0\r\n"
+                                 "Via: SIP/2.0/UDP 192.168.179.1:5060;branch=z9hG4bK9A8B7C6D5E4F3A2B\r\n"
+                                 "Record-Route: <sip:192.168.179.1;lr>\r\n"
+                                 "From: \"Phone\" <sip:**611@fritz.box>;tag=A1B2C3D4E5F60718\r\n"
+                                 "To: <sip:620@fritz.box>;tag=1804289383\r\n"
+                                 "Call-ID: 8C2E4A6B1D3F5A7C@192.168.179.1\r\n"
+                                 "CSeq: 104 BYE\r\n"
+                                 "User-Agent: FRITZ!OS\r\n"
+                                 "Content-Length: 0\r\n"
+                                 "\r\n";
+
+constexpr std::string_view INVITE_FROM_SELF = "INVITE sip:620@192.168.170.30:5060;transport=udp SIP/2.0\r\n"
+                                              "Via: SIP/2.0/UDP 192.168.179.1:5060;branch=z9hG4bK1122334455667788\r\n"
+                                              "From: \"620\" <sip:620@fritz.box>;tag=99AABBCCDDEEFF00\r\n"
+                                              "To: <sip:**9@fritz.box>\r\n"
+                                              "Call-ID: 0A0B0C0D0E0F1011@192.168.179.1\r\n"
+                                              "CSeq: 105 INVITE\r\n"
+                                              "Content-Length: 0\r\n"
+                                              "\r\n";
+
+/**
+ * Builds a response to a sent request, e.g. a 401 for the pending REGISTER transaction
+ *
+ * Via, From, Call-ID and CSeq are copied from the request, the To header gets a tag.
+ */
+inline std::string response_to(std::string_view request, std::string_view status_line, std::string_view extra_headers = {})
+{
+    std::string response { status_line };
+    response += "\r\n";
+    size_t pos = request.find("\r\n");
+    while ((pos != std::string_view::npos) && (pos + 2 < request.size()))
+    {
+        const size_t end = request.find("\r\n", pos + 2);
+        const std::string_view line = request.substr(pos + 2, end - pos - 2);
+        if ((line.rfind("Via: ", 0) == 0) || (line.rfind("From: ", 0) == 0) || (line.rfind("Call-ID: ", 0) == 0) || (line.rfind("CSeq: ", 0) == 0))
+        {
+            response.append(line).append("\r\n");
+        }
+        else if (line.rfind("To: ", 0) == 0)
+        {
+            response.append(line).append(";tag=F2B6B3A1E5C0D4A2\r\n");
+        }
+        pos = end;
+    }
+    response.append(extra_headers);
+    response += "Content-Length: 0\r\n\r\n";
+    return response;
+}
+
+} // namespace sip_corpus
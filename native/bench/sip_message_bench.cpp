@@ -0,0 +1,147 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "asio.hpp"
+
+#include "allocation_counter.h"
+#include "null_udp_client.h"
+#include "sip_corpus.h"
+
+#include "sip_client/mbedtls_md5.h"
+#include "sip_client/sip_client.h"
+
+#include <benchmark/benchmark.h>
+
+/**
+ * Same structure as SipClient, but the internal client is accessible,
+ * so that each send_sip_* builder can be triggered directly.
+ */
+class BenchSipClient
+{
+public:
+    using SipClientInternal = SipClientInt<NullUdpClient, MbedtlsMd5, sip_states, BenchSipClient>;
+    using SmlSmT = sml::sm<sip_states<SipClientInternal>, sml::logger<Logger>>;
+
+    explicit BenchSipClient(asio::io_context& io_context)
+        : m_sip { io_context, "620", "secret", "192.168.179.1", "5060", "192.168.170.30", m_sm, *this }
+        , m_sm { m_sip, m_logger }
+    {
+    }
+
+    SipClientInternal& sip()
+    {
+        return m_sip;
+    }
+
+    static NullUdpClient& socket()
+    {
+        return NullUdpClient::instance(SIP_LOCAL_PORT);
+    }
+
+private:
+    SipClientInternal m_sip;
+    Logger m_logger {};
+    SmlSmT m_sm;
+
+    static constexpr uint16_t SIP_LOCAL_PORT = 5060;
+};
+
+template <typename SetupFunc, typename Func>
+static void run_builder(benchmark::State& state, SetupFunc&& setup, Func&& func)
+{
+    asio::io_context io_context;
+    BenchSipClient client { io_context };
+    setup(client);
+    func(client);
+
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        func(client);
+    }
+    allocation_counter.report(state, BenchSipClient::socket().sent_bytes());
+}
+
+template <typename Func>
+static void run_builder(benchmark::State& state, Func&& func)
+{
+    run_builder(state, [](BenchSipClient& /*client*/) {}, std::forward<Func>(func));
+}
+
+static void BM_SendSipRegister(benchmark::State& state)
+{
+    run_builder(state, [](BenchSipClient& client) {
+        client.sip().register_unauth();
+    });
+}
+BENCHMARK(BM_SendSipRegister);
+
+static void BM_SendSipRegisterAuth(benchmark::State& state)
+{
+    run_builder(
+        state, [](BenchSipClient& client) {
+            // the 401 provides realm and nonce for the digest, it must match the pending REGISTER
+            client.sip().register_unauth();
+            BenchSipClient::socket().inject(sip_corpus::response_to(BenchSipClient::socket().last_sent(), "SIP/2.0 401 Unauthorized",
+                "WWW-Authenticate: Digest realm=\"fritz.box\", nonce=\"3F1E6E3B2C9D7A44\"\r\n"));
+        },
+        [](BenchSipClient& client) {
+            client.sip().register_auth();
+        });
+}
+BENCHMARK(BM_SendSipRegisterAuth);
+
+static void BM_SendSipInvite(benchmark::State& state)
+{
+    run_builder(state, [](BenchSipClient& client) {
+        client.sip().send_invite(ev_initiate_call {});
+    });
+}
+BENCHMARK(BM_SendSipInvite);
+
+static void BM_SendSipCancel(benchmark::State& state)
+{
+    run_builder(state, [](BenchSipClient& client) {
+        client.sip().cancel_call(ev_cancel_call {});
+    });
+}
+BENCHMARK(BM_SendSipCancel);
+
+static void BM_SendSipAck(benchmark::State& state)
+{
+    run_builder(state, [](BenchSipClient& client) {
+        client.sip().call_established();
+    });
+}
+BENCHMARK(BM_SendSipAck);
+
+/* The replies are triggered by received requests, so these include receiving and parsing the request */
+
+static void BM_SendSipOk(benchmark::State& state)
+{
+    run_builder(state, [](BenchSipClient& /*client*/) {
+        BenchSipClient::socket().inject(sip_corpus::NOTIFY);
+    });
+}
+BENCHMARK(BM_SendSipOk);
+
+static void BM_SendSipDecline(benchmark::State& state)
+{
+    run_builder(state, [](BenchSipClient& /*client*/) {
+        BenchSipClient::socket().inject(sip_corpus::INVITE_FROM_SELF);
+    });
+}
+BENCHMARK(BM_SendSipDecline);
@@ -0,0 +1,42 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "allocation_counter.h"
+#include "sip_corpus.h"
+
+#include "sip_client/sip_packet.h"
+
+#include <benchmark/benchmark.h>
+
+static void BM_SipPacketParse(benchmark::State& state, std::string_view message)
+{
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        SipPacket packet(message.data(), message.size());
+        bool result = packet.parse();
+        benchmark::DoNotOptimize(result);
+        benchmark::DoNotOptimize(&packet);
+    }
+    allocation_counter.report(state, message.size());
+}
+
+BENCHMARK_CAPTURE(BM_SipPacketParse, register_401, sip_corpus::REGISTER_401);
+BENCHMARK_CAPTURE(BM_SipPacketParse, register_200, sip_corpus::REGISTER_200);
+BENCHMARK_CAPTURE(BM_SipPacketParse, invite, sip_corpus::INVITE);
+BENCHMARK_CAPTURE(BM_SipPacketParse, info_dtmf, sip_corpus::INFO_DTMF);
+BENCHMARK_CAPTURE(BM_SipPacketParse, notify, sip_corpus::NOTIFY);
+BENCHMARK_CAPTURE(BM_SipPacketParse, bye, sip_corpus::BYE);
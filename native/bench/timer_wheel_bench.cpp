@@ -0,0 +1,114 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "asio.hpp"
+
+#include "allocation_counter.h"
+
+#include "sip_client/timer_wheel.h"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/**
+ * Durations between 1 s and 64 s, so that the pending timers are spread over several wheel levels
+ */
+static std::chrono::milliseconds duration_of(size_t index)
+{
+    return std::chrono::milliseconds(1000 + (index * 7919) % 63000);
+}
+
+/**
+ * Restarting (cancel and start) one of many pending timers of the timer wheel,
+ * e.g. a retransmission timer after a response
+ */
+static void BM_TimerWheelRestart(benchmark::State& state)
+{
+    const auto timers_count = static_cast<size_t>(state.range(0));
+    asio::io_context io_context;
+    const std::shared_ptr<TimerWheel> wheel = TimerWheel::acquire(io_context);
+    std::vector<TimerWheel::Timer> timers(timers_count);
+    size_t fired = 0;
+    for (size_t i = 0; i < timers_count; i++)
+    {
+        wheel->start(timers[i], duration_of(i), [&fired]() {
+            fired++;
+        });
+    }
+
+    size_t index = 0;
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        wheel->start(timers[index], duration_of(index + 1), [&fired]() {
+            fired++;
+        });
+        index = (index + 1 == timers_count) ? 0 : index + 1;
+    }
+    allocation_counter.report(state, 0);
+    benchmark::DoNotOptimize(fired);
+    state.counters["timers"] = benchmark::Counter(static_cast<double>(wheel->size()));
+    state.counters["bytes/timer"] = benchmark::Counter(static_cast<double>(sizeof(TimerWheel::Timer)));
+}
+BENCHMARK(BM_TimerWheelRestart)->Arg(10000);
+
+/**
+ * The same with one asio::steady_timer per timer, as used for the timers of the sip client before
+ *
+ * Restarting a steady_timer cancels the pending wait, whose handler has to run before it is freed,
+ * so the io_context is polled in each iteration.
+ */
+static void BM_SteadyTimerRestart(benchmark::State& state)
+{
+    const auto timers_count = static_cast<size_t>(state.range(0));
+    asio::io_context io_context;
+    std::vector<std::unique_ptr<asio::steady_timer>> timers;
+    timers.reserve(timers_count);
+    size_t fired = 0;
+    const auto start = [&fired](asio::steady_timer& timer, std::chrono::milliseconds duration) {
+        timer.expires_after(duration);
+        timer.async_wait([&fired](const asio::error_code& ec) {
+            if (!ec)
+            {
+                fired++;
+            }
+        });
+    };
+    const size_t allocated_before = AllocationStats::allocated_bytes.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < timers_count; i++)
+    {
+        timers.push_back(std::make_unique<asio::steady_timer>(io_context));
+        start(*timers.back(), duration_of(i));
+    }
+    const size_t allocated = AllocationStats::allocated_bytes.load(std::memory_order_relaxed) - allocated_before;
+
+    size_t index = 0;
+    const AllocationCounter allocation_counter;
+    for (auto _ : state)
+    {
+        start(*timers[index], duration_of(index + 1));
+        io_context.poll();
+        index = (index + 1 == timers_count) ? 0 : index + 1;
+    }
+    allocation_counter.report(state, 0);
+    benchmark::DoNotOptimize(fired);
+    state.counters["timers"] = benchmark::Counter(static_cast<double>(timers_count));
+    state.counters["bytes/timer"] = benchmark::Counter(static_cast<double>(allocated / timers_count));
+}
+BENCHMARK(BM_SteadyTimerRestart)->Arg(10000);
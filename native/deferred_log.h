@@ -0,0 +1,330 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Log, that defers the formatting of the messages to a background thread
+ *
+ * log() only copies the format pointer and the arguments into a record of a single producer,
+ * single consumer ring buffer. Strings (%s) are copied, because they usually point into buffers,
+ * that are reused right after the call. They are truncated to TEXT_SIZE bytes per record.
+ * The background thread formats and prints the records in order.
+ *
+ * log() never blocks: if the ring is full, the record is dropped and counted.
+ * Only one thread may call log(), e.g. the thread running the io_context.
+ */
+class DeferredLog
+{
+public:
+    static constexpr size_t CAPACITY = 256;
+    static constexpr size_t ARGS_SIZE = 64;
+    static constexpr size_t TEXT_SIZE = 1024;
+
+    explicit DeferredLog(FILE* output)
+        : m_output(output)
+        , m_records(std::make_unique<std::array<Record, CAPACITY>>())
+        , m_thread([this]() { run(); })
+    {
+    }
+
+    ~DeferredLog()
+    {
+        m_stop.store(true, std::memory_order_release);
+        m_thread.join();
+    }
+
+    DeferredLog(const DeferredLog&) = delete;
+    DeferredLog(DeferredLog&&) = delete;
+
+    DeferredLog& operator=(const DeferredLog&) = delete;
+    DeferredLog& operator=(DeferredLog&&) = delete;
+
+    /**
+     * The log used by ESP_LOG*, it prints to stdout
+     */
+    static DeferredLog& instance()
+    {
+        static DeferredLog log(stdout);
+        return log;
+    }
+
+    /**
+     * Queues the message for formatting with fprintf("[level] [tag] " fmt "\n", args...)
+     *
+     * level, tag and fmt must be string literals (or live as long as the log).
+     */
+    template <typename... ArgsT>
+    void log(const char* level, const char* tag, const char* fmt, const ArgsT&... args)
+    {
+        using StoredT = std::tuple<Stored<ArgsT>...>;
+        static_assert(sizeof(StoredT) <= ARGS_SIZE, "Too many log arguments");
+        static_assert(alignof(StoredT) <= alignof(std::max_align_t), "Unsupported log argument");
+
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == CAPACITY)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Record& record = (*m_records)[head % CAPACITY];
+        record.format = &format<ArgsT...>;
+        record.level = level;
+        record.tag = tag;
+        record.fmt = fmt;
+
+        if constexpr (sizeof...(ArgsT) > 0)
+        {
+            store_all(record, std::index_sequence_for<ArgsT...> {}, args...);
+        }
+
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * Number of records, that were dropped because the ring was full
+     */
+    [[nodiscard]] size_t dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Waits until the background thread printed all queued records
+     */
+    void flush() const
+    {
+        while (m_tail.load(std::memory_order_acquire) != m_head.load(std::memory_order_acquire))
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+private:
+    /**
+     * Offset of a stored string in the text of the record, a distinct type, so that it is not
+     * mistaken for an uint16_t argument
+     */
+    struct TextRef
+    {
+        uint16_t offset;
+    };
+
+    /**
+     * Strings are stored as TextRef, everything else as value
+     */
+    template <typename T>
+    using Stored = std::conditional_t<std::is_convertible_v<T, const char*>, TextRef, std::decay_t<T>>;
+
+    struct Record
+    {
+        void (*format)(FILE*, const Record&) { nullptr };
+        const char* level { nullptr };
+        const char* tag { nullptr };
+        const char* fmt { nullptr };
+        alignas(std::max_align_t) std::array<unsigned char, ARGS_SIZE> args {};
+        std::array<char, TEXT_SIZE> text {};
+    };
+
+    /**
+     * How the argument is used by the format string, only needed to know how much of a string to copy
+     */
+    struct StringSpec
+    {
+        bool is_string { false };
+        /** Precision from the argument before (%.*s) */
+        bool precision_from_arg { false };
+        /** Precision from the format string (%.10s), -1 if none */
+        int precision { -1 };
+    };
+
+    /**
+     * Assigns the conversions of the format string to the arguments, * for width and precision consume one argument
+     */
+    static void parse_format(const char* fmt, StringSpec* specs, size_t count)
+    {
+        size_t index = 0;
+        for (const char* c = fmt; (*c != '\0') && (index < count); c++)
+        {
+            if (*c != '%')
+            {
+                continue;
+            }
+            c++;
+            if (*c == '%')
+            {
+                continue;
+            }
+            StringSpec spec;
+            for (; (*c != '\0') && (std::strchr("diouxXeEfFgGaAcspn", *c) == nullptr); c++)
+            {
+                if (*c == '*')
+                {
+                    if (*(c - 1) == '.')
+                    {
+                        spec.precision_from_arg = true;
+                    }
+                    index++;
+                }
+                else if (*c == '.')
+                {
+                    spec.precision = 0;
+                    for (; (*(c + 1) >= '0') && (*(c + 1) <= '9'); c++)
+                    {
+                        spec.precision = spec.precision * 10 + (*(c + 1) - '0');
+                    }
+                }
+            }
+            if ((*c == 's') && (index < count))
+            {
+                spec.is_string = true;
+                specs[index] = spec;
+            }
+            index++;
+            if (*c == '\0')
+            {
+                break;
+            }
+        }
+    }
+
+    template <typename... ArgsT, size_t... INDICES>
+    static void store_all(Record& record, std::index_sequence<INDICES...> /*unused*/, const ArgsT&... args)
+    {
+        std::array<StringSpec, sizeof...(ArgsT)> specs {};
+        parse_format(record.fmt, specs.data(), specs.size());
+        size_t text_used = 0;
+        int last_int = -1;
+        // the elements of a braced list are evaluated in order, so last_int is the argument before
+        new (record.args.data()) std::tuple<Stored<ArgsT>...> { store(args, specs[INDICES], last_int, record.text, text_used)... };
+    }
+
+    template <typename T>
+    static Stored<T> store(const T& arg, const StringSpec& spec, int& last_int, std::array<char, TEXT_SIZE>& text, size_t& text_used)
+    {
+        if constexpr (std::is_convertible_v<T, const char*>)
+        {
+            const char* string = arg;
+            if (text_used == TEXT_SIZE)
+            {
+                // the text is full, point to the terminating zero of the last string
+                return TextRef { static_cast<uint16_t>(TEXT_SIZE - 1) };
+            }
+            const TextRef ref { static_cast<uint16_t>(text_used) };
+            size_t length = 0;
+            if (spec.is_string && (string != nullptr))
+            {
+                size_t limit = TEXT_SIZE - 1 - text_used;
+                const int precision = spec.precision_from_arg ? last_int : spec.precision;
+                if ((precision >= 0) && (static_cast<size_t>(precision) < limit))
+                {
+                    limit = static_cast<size_t>(precision);
+                }
+                length = strnlen(string, limit);
+                std::memcpy(text.data() + text_used, string, length);
+            }
+            text[text_used + length] = '\0';
+            text_used += length + 1;
+            return ref;
+        }
+        else
+        {
+            if constexpr (std::is_integral_v<T>)
+            {
+                last_int = static_cast<int>(arg);
+            }
+            return arg;
+        }
+    }
+
+    template <typename... ArgsT>
+    static void format(FILE* output, const Record& record)
+    {
+        using StoredT = std::tuple<Stored<ArgsT>...>;
+        const auto& stored = *std::launder(reinterpret_cast<const StoredT*>(record.args.data()));
+        const auto load = [&record](const auto& value) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(value)>, TextRef>)
+            {
+                return record.text.data() + value.offset;
+            }
+            else
+            {
+                return value;
+            }
+        };
+        std::fprintf(output, "[%s] [%s] ", record.level, record.tag);
+        std::apply([&](const auto&... values) {
+            // the format string is one of the callers, e.g. of ESP_LOGI
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-security"
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+            std::fprintf(output, record.fmt, load(values)...);
+#pragma GCC diagnostic pop
+        },
+            stored);
+        std::fputc('\n', output);
+    }
+
+    void run()
+    {
+        for (;;)
+        {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire))
+            {
+                if (m_stop.load(std::memory_order_acquire))
+                {
+                    break;
+                }
+                std::fflush(m_output);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            const Record& record = (*m_records)[tail % CAPACITY];
+            record.format(m_output, record);
+            m_tail.store(tail + 1, std::memory_order_release);
+        }
+        if (m_dropped.load(std::memory_order_relaxed) > 0)
+        {
+            std::fprintf(m_output, "[WARN] [DeferredLog] %zu records dropped\n", m_dropped.load(std::memory_order_relaxed));
+        }
+        std::fflush(m_output);
+    }
+
+    FILE* m_output;
+    std::unique_ptr<std::array<Record, CAPACITY>> m_records;
+    /** Written by the producer */
+    alignas(64) std::atomic<size_t> m_head { 0 };
+    /** Written by the consumer */
+    alignas(64) std::atomic<size_t> m_tail { 0 };
+    std::atomic<size_t> m_dropped { 0 };
+    std::atomic<bool> m_stop { false };
+    std::thread m_thread;
+};
@@ -3,6 +3,36 @@
 #include <cstdarg>
 #include <cstdio>
 
+/* Levels as in esp-idf, LOG_LOCAL_LEVEL is the highest level, that is compiled in.
+ * The calls of the other levels are removed completely, their arguments are not evaluated.
+ * With LOG_DEFERRED the messages are formatted by a background thread, see deferred_log.h.
+ */
+#define ESP_LOG_NONE 0
+#define ESP_LOG_ERROR 1
+#define ESP_LOG_WARN 2
+#define ESP_LOG_INFO 3
+#define ESP_LOG_DEBUG 4
+#define ESP_LOG_VERBOSE 5
+
+#ifndef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_INFO
+#endif
+
+#ifdef LOG_DEFERRED
+
+#include "deferred_log.h"
+
+#define ESP_LOG_LEVEL_LOCAL(level, level_name, prefix, fmt, ...)                       \
+    do                                                                                 \
+    {                                                                                  \
+        if constexpr (LOG_LOCAL_LEVEL >= (level))                                      \
+        {                                                                              \
+            DeferredLog::instance().log(level_name, prefix, fmt, ##__VA_ARGS__);       \
+        }                                                                              \
+    } while (false)
+
+#else
+
 static inline void my_log(const char* level, const char* prefix, const char* fmt, ...)
 {
     printf("[%s] ", level);
@@ -14,8 +44,19 @@ static inline void my_log(const char* level, const char* prefix, const char* fmt
     printf("\n");
 }
 
-#define ESP_LOGE(prefix, fmt, ...) my_log("ERR", prefix, fmt, ##__VA_ARGS__)
-#define ESP_LOGW(prefix, fmt, ...) my_log("WARN", prefix, fmt, ##__VA_ARGS__)
-#define ESP_LOGI(prefix, fmt, ...) my_log("INFO", prefix, fmt, ##__VA_ARGS__)
-#define ESP_LOGD(prefix, fmt, ...) my_log("DBG", prefix, fmt, ##__VA_ARGS__)
-#define ESP_LOGV(prefix, fmt, ...) my_log("VER", prefix, fmt, ##__VA_ARGS__)
+#define ESP_LOG_LEVEL_LOCAL(level, level_name, prefix, fmt, ...) \
+    do                                                           \
+    {                                                            \
+        if constexpr (LOG_LOCAL_LEVEL >= (level))                \
+        {                                                        \
+            my_log(level_name, prefix, fmt, ##__VA_ARGS__);      \
+        }                                                        \
+    } while (false)
+
+#endif /* LOG_DEFERRED */
+
+#define ESP_LOGE(prefix, fmt, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_ERROR, "ERR", prefix, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(prefix, fmt, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN, "WARN", prefix, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(prefix, fmt, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_INFO, "INFO", prefix, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(prefix, fmt, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG, "DBG", prefix, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(prefix, fmt, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_VERBOSE, "VER", prefix, fmt, ##__VA_ARGS__)
@@ -17,13 +17,17 @@
 #include "asio.hpp"
 
 #include "sip_client/asio_udp_client.h"
+#include "sip_client/g711.h"
 #include "sip_client/mbedtls_md5.h"
+#include "sip_client/mbedtls_sha256.h"
 #include "sip_client/sip_client.h"
 #include "sip_client/sip_client_event_handler.h"
 
 #include "keyboard_input.h"
 
 #include <cstring>
+#include <fstream>
+#include <vector>
 
 constexpr char const* CONFIG_SIP_USER = "620";
 constexpr char const* CONFIG_SIP_PASSWORD = "secret";
@@ -34,9 +38,16 @@ constexpr char const* CONFIG_LOCAL_IP = "192.168.170.30";
 constexpr char const* CONFIG_CALL_TARGET_USER = "9170";
 constexpr char const* CONFIG_CALLER_DISPLAY_MESSAGE = "CMDLine";
 
+/**
+ * Played in each established call, raw 8 kHz mono 16 bit samples, e.g. converted with
+ * sox announcement.wav -r 8000 -c 1 -b 16 -e signed-integer announcement.raw
+ * Empty for no announcement.
+ */
+constexpr char const* CONFIG_ANNOUNCEMENT_FILE = "";
+
 static constexpr char const* TAG = "main";
 
-using SipClientT = SipClient<AsioUdpClient, MbedtlsMd5>;
+using SipClientT = SipClient<AsioUdpClient, MbedtlsMd5, MbedtlsSha256>;
 
 struct handlers_t
 {
@@ -47,6 +58,25 @@ struct handlers_t
 
 static void sip_task(void* pvParameters);
 
+/**
+ * Encodes the announcement once at startup, nothing is encoded while it is played
+ */
+static Announcement load_announcement(const char* file_name)
+{
+    std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        ESP_LOGE(TAG, "Failed to open announcement %s", file_name);
+        return {};
+    }
+    std::vector<int16_t> samples(static_cast<size_t>(file.tellg()) / sizeof(int16_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(samples.data()), static_cast<std::streamsize>(samples.size() * sizeof(int16_t)));
+    Announcement announcement = Announcement::encode<PcmuCodec>(samples.data(), samples.size());
+    ESP_LOGI(TAG, "Loaded announcement %s with %d frames", file_name, static_cast<int>(announcement.frame_count()));
+    return announcement;
+}
+
 void sip_task(void* pvParameters)
 {
     auto* ctx = static_cast<handlers_t*>(pvParameters);
@@ -105,6 +135,12 @@ int main(int /*unused*/, char** /*unused*/)
 
     SipClientT client { io_context, CONFIG_SIP_USER, CONFIG_SIP_PASSWORD, CONFIG_SIP_SERVER_IP, CONFIG_SIP_SERVER_PORT, CONFIG_LOCAL_IP };
 
+    const Announcement announcement = (*CONFIG_ANNOUNCEMENT_FILE != '\0') ? load_announcement(CONFIG_ANNOUNCEMENT_FILE) : Announcement {};
+    if (announcement.frame_count() > 0)
+    {
+        client.set_announcement(&announcement);
+    }
+
     KeyboardInput input { io_context };
 
     handlers_t handlers { client, input, io_context };
@@ -0,0 +1,56 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "udp_client_test.h"
+
+#include "sip_client/shared_udp_client.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using SharedUdpClientTest = UdpClientTest;
+
+/**
+ * E.g. the re-registrations of all accounts are due at the same time
+ */
+TEST_F(SharedUdpClientTest, SendsTheMessagesOfAllAccountsAtOnce)
+{
+    constexpr int ACCOUNTS = 200;
+    std::vector<std::unique_ptr<SharedUdpClient<AsioUdpClient>>> accounts;
+    for (int i = 0; i < ACCOUNTS; i++)
+    {
+        accounts.push_back(std::make_unique<SharedUdpClient<AsioUdpClient>>(m_io_context, "127.0.0.1", server_port(), CLIENT_PORT, [](std::string_view /*data*/) {}));
+        ASSERT_TRUE(accounts.back()->init());
+    }
+
+    for (int i = 0; i < ACCOUNTS; i++)
+    {
+        accounts[i]->get_new_tx_buf() << "REGISTER sip:127.0.0.1 SIP/2.0\r\n"
+                                      << "To: <sip:" << static_cast<unsigned>(i) << "@127.0.0.1>\r\n"
+                                      << "Call-ID: " << static_cast<unsigned>(i) << "\r\n\r\n";
+        EXPECT_TRUE(accounts[i]->send_buffered_data());
+    }
+
+    const std::vector<std::string> received = receive_at_server(ACCOUNTS);
+    ASSERT_EQ(received.size(), static_cast<size_t>(ACCOUNTS));
+    for (int i = 0; i < ACCOUNTS; i++)
+    {
+        EXPECT_NE(received[i].find("Call-ID: " + std::to_string(i) + "\r\n"), std::string::npos);
+    }
+}
@@ -0,0 +1,205 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "asio.hpp"
+
+#include "bench/sip_corpus.h"
+
+#include "sip_client/asio_udp_client.h"
+#include "sip_client/mbedtls_md5.h"
+#include "sip_client/sip_client.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps the sent messages, received messages are injected by the test
+ */
+class CaptureUdpClient
+{
+public:
+    CaptureUdpClient(asio::io_context& /*io_context*/, const std::string& /*server_ip*/, const std::string& /*server_port*/, uint16_t local_port, RxCallbackT on_received)
+        : m_local_port(local_port)
+        , m_on_received { on_received }
+    {
+        instances()[m_local_port] = this;
+    }
+
+    ~CaptureUdpClient()
+    {
+        instances().erase(m_local_port);
+    }
+
+    CaptureUdpClient(const CaptureUdpClient&) = delete;
+    CaptureUdpClient& operator=(const CaptureUdpClient&) = delete;
+
+    static CaptureUdpClient& instance(uint16_t local_port)
+    {
+        return *instances().at(local_port);
+    }
+
+    bool init()
+    {
+        m_initialized = true;
+        return true;
+    }
+
+    void deinit()
+    {
+        m_initialized = false;
+    }
+
+    [[nodiscard]] bool is_initialized() const
+    {
+        return m_initialized;
+    }
+
+    void set_server_ip(const std::string& /*server_ip*/)
+    {
+    }
+
+    bool set_destination(std::string_view /*ip*/, uint16_t /*port*/)
+    {
+        return true;
+    }
+
+    TxBufferT& get_new_tx_buf()
+    {
+        m_tx_buffer.clear();
+        return m_tx_buffer;
+    }
+
+    template <typename... Fragments>
+    bool send_buffered_data(const Fragments&... body)
+    {
+        std::string message(m_tx_buffer.data(), m_tx_buffer.size());
+        (message.append(static_cast<const char*>(asio::const_buffer(body).data()), asio::const_buffer(body).size()), ...);
+        m_sent.push_back(message);
+        return true;
+    }
+
+    void inject(std::string_view data)
+    {
+        m_on_received(data);
+    }
+
+    /**
+     * The last sent message, that starts with the method, empty if there is none
+     */
+    [[nodiscard]] std::string last_sent(std::string_view method) const
+    {
+        for (auto it = m_sent.rbegin(); it != m_sent.rend(); ++it)
+        {
+            if (it->rfind(method, 0) == 0)
+            {
+                return *it;
+            }
+        }
+        return {};
+    }
+
+    [[nodiscard]] const std::vector<std::string>& sent() const
+    {
+        return m_sent;
+    }
+
+private:
+    static std::map<uint16_t, CaptureUdpClient*>& instances()
+    {
+        static std::map<uint16_t, CaptureUdpClient*> sockets;
+        return sockets;
+    }
+
+    const uint16_t m_local_port;
+    RxCallbackT m_on_received;
+    TxBufferT m_tx_buffer;
+    std::vector<std::string> m_sent;
+    bool m_initialized { false };
+};
+
+using TestSipClient = SipClient<CaptureUdpClient, MbedtlsMd5>;
+
+/**
+ * A registered client, that sends and receives through a CaptureUdpClient
+ */
+class SipClientTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        m_client.set_event_handler([this](TestSipClient& /*client*/, const SipClientEvent& event) {
+            m_events.push_back(event);
+        });
+        ASSERT_TRUE(m_client.init());
+        run();
+        m_socket.inject(sip_corpus::response_to(m_socket.last_sent("REGISTER "), "SIP/2.0 200 OK", "Contact: <sip:620@192.168.170.30:5060;transport=udp>;expires=300\r\n"));
+        run();
+    }
+
+    void run()
+    {
+        m_io_context.poll();
+        m_io_context.restart();
+    }
+
+    asio::io_context m_io_context;
+    TestSipClient m_client { m_io_context, "620", "secret", "192.168.179.1", "5060", "192.168.170.30" };
+    CaptureUdpClient& m_socket { CaptureUdpClient::instance(TestSipClient::DEFAULT_LOCAL_PORT) };
+    std::vector<SipClientEvent> m_events;
+};
+
+/**
+ * A final response without an event of its own must not leave the call pending
+ */
+TEST_F(SipClientTest, AcksNotFoundAndEndsTheCall)
+{
+    m_client.request_ring("**610", "Door");
+    run();
+    const std::string invite = m_socket.last_sent("INVITE ");
+    ASSERT_FALSE(invite.empty());
+
+    m_socket.inject(sip_corpus::response_to(invite, "SIP/2.0 404 Not Found"));
+    run();
+
+    const std::string ack = m_socket.last_sent("ACK ");
+    ASSERT_FALSE(ack.empty());
+    EXPECT_NE(ack.find(";tag=F2B6B3A1E5C0D4A2\r\n"), std::string::npos);
+    ASSERT_EQ(m_events.size(), 1U);
+    EXPECT_EQ(m_events[0].event, SipClientEvent::Event::CALL_CANCELLED);
+    EXPECT_EQ(m_events[0].cancel_reason, SipClientEvent::CancelReason::CALL_FAILED);
+
+    // back in registered, the next call is sent
+    m_client.request_ring("**611", "Door");
+    run();
+    EXPECT_NE(m_socket.last_sent("INVITE ").find("INVITE sip:**611@"), std::string::npos);
+}
+
+TEST_F(SipClientTest, IgnoresProvisionalResponsesWithoutEvent)
+{
+    m_client.request_ring("**610", "Door");
+    run();
+    const std::string invite = m_socket.last_sent("INVITE ");
+    const size_t sent = m_socket.sent().size();
+
+    m_socket.inject(sip_corpus::response_to(invite, "SIP/2.0 180 Ringing"));
+    run();
+
+    EXPECT_EQ(m_socket.sent().size(), sent);
+    EXPECT_TRUE(m_events.empty());
+}
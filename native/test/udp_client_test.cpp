@@ -0,0 +1,90 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "udp_client_test.h"
+
+#include "sip_client/asio_udp_client.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+/**
+ * A whole recvmmsg() batch is handled at once, so its replies are queued before the first one is sent
+ */
+TEST_F(UdpClientTest, RepliesToAllMessagesOfAReceiveBatch)
+{
+    AsioUdpClient client(m_io_context, "127.0.0.1", server_port(), CLIENT_PORT, [&client](std::string_view data) {
+        client.get_new_tx_buf() << "SIP/2.0 200 OK\r\n"
+                                << data.substr(data.find("CSeq:"));
+        client.send_buffered_data();
+    });
+    ASSERT_TRUE(client.init());
+
+    static_assert(RX_BATCH_SIZE > TX_QUEUE_DEPTH, "the batch does not overflow the tx buffers");
+    for (int i = 0; i < RX_BATCH_SIZE; i++)
+    {
+        send_to_client("NOTIFY sip:620@127.0.0.1 SIP/2.0\r\nCSeq: " + std::to_string(i) + " NOTIFY\r\n\r\n");
+    }
+
+    const std::vector<std::string> replies = receive_at_server(RX_BATCH_SIZE);
+    ASSERT_EQ(replies.size(), static_cast<size_t>(RX_BATCH_SIZE));
+    for (int i = 0; i < RX_BATCH_SIZE; i++)
+    {
+        EXPECT_EQ(replies[i], "SIP/2.0 200 OK\r\nCSeq: " + std::to_string(i) + " NOTIFY\r\n\r\n");
+    }
+}
+
+TEST_F(UdpClientTest, SendsTheBacklogWithBodiesInOrder)
+{
+    AsioUdpClient client(m_io_context, "127.0.0.1", server_port(), CLIENT_PORT, [](std::string_view /*data*/) {});
+    ASSERT_TRUE(client.init());
+
+    constexpr int COUNT = 3 * TX_QUEUE_DEPTH;
+    std::array<std::string, COUNT> bodies;
+    for (int i = 0; i < COUNT; i++)
+    {
+        client.get_new_tx_buf() << "MESSAGE " << static_cast<unsigned>(i) << "|";
+        bodies[i] = "body " + std::to_string(i);
+        ASSERT_TRUE(client.send_buffered_data(asio::buffer(bodies[i])));
+    }
+
+    const std::vector<std::string> received = receive_at_server(COUNT);
+    ASSERT_EQ(received.size(), static_cast<size_t>(COUNT));
+    for (int i = 0; i < COUNT; i++)
+    {
+        EXPECT_EQ(received[i], "MESSAGE " + std::to_string(i) + "|body " + std::to_string(i));
+    }
+}
+
+TEST_F(UdpClientTest, DropsMessagesBeyondTheBacklogLimit)
+{
+    AsioUdpClient client(m_io_context, "127.0.0.1", server_port(), CLIENT_PORT, [](std::string_view /*data*/) {});
+    ASSERT_TRUE(client.init());
+    client.set_tx_backlog_limit(1);
+
+    for (int i = 0; i < TX_QUEUE_DEPTH + 1; i++)
+    {
+        client.get_new_tx_buf() << "MESSAGE";
+        EXPECT_TRUE(client.send_buffered_data());
+    }
+    client.get_new_tx_buf() << "MESSAGE";
+    EXPECT_FALSE(client.send_buffered_data());
+
+    EXPECT_EQ(receive_at_server(TX_QUEUE_DEPTH + 1).size(), static_cast<size_t>(TX_QUEUE_DEPTH + 1));
+}
@@ -0,0 +1,83 @@
+/*
+   Copyright Christian Taedcke <hacking@taedcke.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include "asio.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+static constexpr uint16_t CLIENT_PORT = 25060;
+
+/**
+ * A server socket on localhost, that is the destination of the client
+ */
+class UdpClientTest : public ::testing::Test
+{
+protected:
+    void send_to_client(const std::string& message)
+    {
+        m_server.send_to(asio::buffer(message), asio::ip::udp::endpoint(asio::ip::make_address_v4("127.0.0.1"), CLIENT_PORT));
+    }
+
+    /**
+     * Runs the io_context until the count of datagrams is received by the server or a timeout
+     */
+    std::vector<std::string> receive_at_server(size_t count)
+    {
+        std::vector<std::string> received;
+        std::array<char, 2048> buffer {};
+        asio::ip::udp::endpoint sender;
+        std::function<void()> receive = [&]() {
+            m_server.async_receive_from(asio::buffer(buffer), sender, [&](std::error_code ec, size_t length) {
+                if (ec)
+                {
+                    return;
+                }
+                received.emplace_back(buffer.data(), length);
+                if (received.size() < count)
+                {
+                    receive();
+                }
+            });
+        };
+        receive();
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while ((received.size() < count) && (std::chrono::steady_clock::now() < deadline))
+        {
+            m_io_context.run_for(std::chrono::milliseconds(10));
+            m_io_context.restart();
+        }
+        m_server.cancel();
+        m_io_context.poll();
+        m_io_context.restart();
+        return received;
+    }
+
+    [[nodiscard]] std::string server_port() const
+    {
+        return std::to_string(m_server.local_endpoint().port());
+    }
+
+    asio::io_context m_io_context;
+    asio::ip::udp::socket m_server { m_io_context, asio::ip::udp::endpoint(asio::ip::make_address_v4("127.0.0.1"), 0) };
+};